@@ -3,6 +3,7 @@
 #include "../common/Net.hpp"
 #include "../common/Message.hpp"
 #include <future>
+#include <map>
 
 using namespace base;
 
@@ -12,10 +13,16 @@ public:
     using Ptr = std::shared_ptr<Requestor>;
     using AsyncResponse = std::future<BaseMessage::Ptr>;
     using RequestCallback = std::function<void(const BaseMessage::Ptr&)>;
+    // 为没有得到结果的请求选择另一条连接，返回空表示不重发；
+    // reason 为 RCODE_DISCONNECTED(连接断开，请求可能已被处理) 或 RCODE_SERVER_DRAINING(服务端下线，请求没有被处理)
+    using FailoverHandler = std::function<BaseConnection::Ptr(const BaseConnection::Ptr& failed,
+                                                              const BaseMessage::Ptr& req, ResCode reason)>;
     struct RequestDescribe
     {
         using Ptr = std::shared_ptr<RequestDescribe>;
         BaseMessage::Ptr request;
+        std::weak_ptr<BaseConnection> conn; ///< 请求所在的连接；弱引用持有控制块，连接释放后地址被复用也不会与新连接混淆
+        int retries = 0; ///< 已经改发到其他连接的次数
         RequestType rtype;
         std::promise<BaseMessage::Ptr> response;
         RequestCallback callback;
@@ -34,29 +41,64 @@ public:
             LOG_ERROR("收到响应 '{}', 但是未找到对应的请求描述", rid);
             return;
         }
-        if(rdp->rtype == RequestType::REQUEST_ASYNC){
-            rdp->response.set_value(msg);
+        // 只有成功撤回请求描述的一方交付结果，避免与 OnClose 重复交付
+        if(__DelDescribe(rid) == false){
+            return;
         }
-        else if(rdp->rtype == RequestType::REQUEST_CALLBACK){
-            if(rdp->callback) rdp->callback(msg);
+        // 服务端正在下线，请求没有被处理，与连接断开一样改发到其他连接
+        auto rsp = std::dynamic_pointer_cast<JsonResponse>(msg);
+        if(rsp.get() != nullptr && rsp->Rcode() == ResCode::RCODE_SERVER_DRAINING &&
+           __Failover(conn, rdp, ResCode::RCODE_SERVER_DRAINING)){
+            return;
         }
-        else{
-            LOG_ERROR("请求类型未知");
+        __Complete(rdp, msg);
+    }
+    // 在发出请求之前设置，每个请求最多改发 max_retries 次；持有者析构前设置为空，之后关闭的连接不再回调持有者
+    void SetFailoverHandler(const FailoverHandler& handler, int max_retries = 1){
+        std::unique_lock<std::mutex> lock(_mutex);
+        _failover = handler;
+        _max_retries = max_retries;
+    }
+    /**
+     * @brief 连接关闭或连接失败时调用，该连接上所有未完成的请求以 RCODE_DISCONNECTED 结束，调用方不再无限等待
+     * @details 设置了 FailoverHandler 时，每个请求先尝试改发到另一条连接，超过改发次数或没有其他连接才结束
+     */
+    void OnClose(const BaseConnection::Ptr& conn){
+        std::vector<RequestDescribe::Ptr> failed;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            for(auto it = _request_desc.begin(); it != _request_desc.end();){
+                if(__SameConnection(it->second->conn, conn)){
+                    failed.push_back(it->second);
+                    it = _request_desc.erase(it);
+                }
+                else{
+                    ++it;
+                }
+            }
+            _outstanding.erase(conn);
+        }
+        if(failed.empty() == false){
+            LOG_ERROR("连接已断开, {} 个未完成的请求失败", failed.size());
+        }
+        for(auto& rdp : failed){
+            if(__Failover(conn, rdp, ResCode::RCODE_DISCONNECTED)){
+                continue;
+            }
+            __Complete(rdp, __ErrorResponse(rdp->request, ResCode::RCODE_DISCONNECTED));
         }
-        __DelDescribe(rid); // 避免内存泄漏
     }
     /**
      * @brief: 两种响应方式
      */
     bool Send(const BaseConnection::Ptr& conn, const BaseMessage::Ptr& req, AsyncResponse &async_rsq){
-        RequestDescribe::Ptr rdp = __NewDescribe(req, RequestType::REQUEST_ASYNC);
+        RequestDescribe::Ptr rdp = __NewDescribe(conn, req, RequestType::REQUEST_ASYNC);
         if(rdp.get() == nullptr){
             LOG_ERROR("构造请求描述对象失败");
             return false;
         }
-        conn->Send(req);
         async_rsq = rdp->GetAsyncResponse();
-        return true;
+        return __Send(conn, req);
     }
     bool Send(const BaseConnection::Ptr& conn, const BaseMessage::Ptr& req, BaseMessage::Ptr& rsp){
         AsyncResponse rsp_future;
@@ -67,34 +109,109 @@ public:
     }
 
     bool Send(const BaseConnection::Ptr& conn, const BaseMessage::Ptr& req, RequestCallback &callback){
-        RequestDescribe::Ptr rdp = __NewDescribe(req, RequestType::REQUEST_CALLBACK, callback);
+        RequestDescribe::Ptr rdp = __NewDescribe(conn, req, RequestType::REQUEST_CALLBACK, callback);
         if(rdp.get() == nullptr){
             LOG_ERROR("构造请求描述对象失败");
             return false;
         }
         // callback = rdp->callback;
+        return __Send(conn, req);
+    }
+    // 连接上已发出但尚未收到响应的请求数量
+    size_t Outstanding(const BaseConnection::Ptr& conn){
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto it = _outstanding.find(conn);
+        if(it == _outstanding.end()){
+            return 0;
+        }
+        return it->second;
+    }
+private:
+    // 请求描述先于发送登记：连接在此之后关闭时由 OnClose 结束该请求；
+    // 发送前发现连接已关闭，则撤回请求描述，若已被 OnClose 撤回说明失败结果已经交付
+    bool __Send(const BaseConnection::Ptr& conn, const BaseMessage::Ptr& req){
+        if(conn->IsClosed()){
+            if(__DelDescribe(req->Rid())){
+                LOG_ERROR("连接已断开, 请求发送失败");
+                return false;
+            }
+            return true;
+        }
         conn->Send(req);
         return true;
     }
-private:
+    bool __Failover(const BaseConnection::Ptr& failed, const RequestDescribe::Ptr& rdp, ResCode reason){
+        FailoverHandler failover;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if(rdp->retries >= _max_retries){
+                return false;
+            }
+            failover = _failover;
+        }
+        if(!failover){
+            return false;
+        }
+        auto conn = failover(failed, rdp->request, reason);
+        if(conn.get() == nullptr || conn.get() == failed.get() || conn->IsClosed()){
+            return false;
+        }
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            ++rdp->retries;
+            rdp->conn = conn;
+            ++_outstanding[rdp->conn];
+            _request_desc.emplace(rdp->request->Rid(), rdp);
+        }
+        LOG_INFO("请求 '{}' 改发到其他连接", rdp->request->Rid());
+        if(__Send(conn, rdp->request) == false){
+            __Complete(rdp, __ErrorResponse(rdp->request, ResCode::RCODE_DISCONNECTED));
+        }
+        return true;
+    }
+    void __Complete(const RequestDescribe::Ptr& rdp, const BaseMessage::Ptr& msg){
+        if(rdp->rtype == RequestType::REQUEST_ASYNC){
+            rdp->response.set_value(msg);
+        }
+        else if(rdp->rtype == RequestType::REQUEST_CALLBACK){
+            if(rdp->callback) rdp->callback(msg);
+        }
+        else{
+            LOG_ERROR("请求类型未知");
+        }
+    }
+    // 为请求构造一个错误响应，消息类型枚举中每种请求后面紧跟着它的响应类型
+    static BaseMessage::Ptr __ErrorResponse(const BaseMessage::Ptr& req, ResCode rcode){
+        MessType rsp_type = (MessType)((int)req->GetMessType() + 1);
+        auto rsp = std::dynamic_pointer_cast<JsonResponse>(MessageFactory::Create(rsp_type));
+        if(rsp.get() == nullptr){
+            return BaseMessage::Ptr();
+        }
+        rsp->SetId(req->Rid());
+        rsp->SetMessType(rsp_type);
+        rsp->SetRcode(rcode);
+        return rsp;
+    }
     /**
      * @brief: request请求信息管理模块- 增删改查
      */
-    RequestDescribe::Ptr __NewDescribe(const BaseMessage::Ptr& req, RequestType rtype,
+    RequestDescribe::Ptr __NewDescribe(const BaseConnection::Ptr& conn, const BaseMessage::Ptr& req, RequestType rtype,
                                     const RequestCallback &cb = RequestCallback()){
         std::unique_lock<std::mutex> lock(_mutex);
         RequestDescribe::Ptr rd = std::make_shared<RequestDescribe>();
         rd->SetRequest(req);
+        rd->conn = conn;
+        ++_outstanding[rd->conn];
         rd->SetRequestType(rtype);
         if(rtype == RequestType::REQUEST_CALLBACK && cb){
             rd->SetCallback(cb);
         }
-        LOG_INFO("新增请求描述信息: {}", req->Rid());
+        LOG_DEBUG("新增请求描述信息: {}", req->Rid());
         _request_desc.emplace(req->Rid(), rd);
         return rd;
     }
     RequestDescribe::Ptr __GetDescribe(const std::string& rid){
-        LOG_INFO("查找请求描述信息: {}", rid);
+        LOG_DEBUG("查找请求描述信息: {}", rid);
         std::unique_lock<std::mutex> lock(_mutex);
         auto it = _request_desc.find(rid);
         if(it == _request_desc.end()){
@@ -102,12 +219,29 @@ private:
         }
         return it->second;
     }
-    void __DelDescribe(const std::string& rid){
+    // 按控制块比较，连接已经释放时弱引用仍然可以比较
+    static bool __SameConnection(const std::weak_ptr<BaseConnection>& a, const BaseConnection::Ptr& b){
+        return a.owner_before(b) == false && b.owner_before(a) == false;
+    }
+    bool __DelDescribe(const std::string& rid){
         std::unique_lock<std::mutex> lock(_mutex);
-        _request_desc.erase(rid);
+        auto it = _request_desc.find(rid);
+        if(it == _request_desc.end()){
+            return false;
+        }
+        auto count = _outstanding.find(it->second->conn);
+        if(count != _outstanding.end() && --count->second == 0){
+            _outstanding.erase(count); // 计数归零即删除，连接释放后不会残留
+        }
+        _request_desc.erase(it);
+        return true;
     }
 private:
     std::mutex _mutex;
     std::unordered_map<std::string, RequestDescribe::Ptr> _request_desc; ///< id->request 映射表
+    // 连接->未完成请求数量，以弱引用为键：计数归零或连接关闭时删除
+    std::map<std::weak_ptr<BaseConnection>, size_t, std::owner_less<>> _outstanding;
+    FailoverHandler _failover;
+    int _max_retries = 1; ///< 每个请求最多改发的次数
 };
 }
\ No newline at end of file
@@ -64,7 +64,7 @@ public:
         // 2. 发送请求
         bool ret = _requestor->Send(conn, req_msg, cb);
         if(ret == false){
-            LOG_ERROR("同步Rpc请求失败");
+            LOG_ERROR("异步Rpc请求失败");
             return false;
         }
         return true;
@@ -101,14 +101,17 @@ private:
         callback(rpc_res->Result());
     }
 
+    // 出错时以异常的形式交给future，调用方get时得到错误原因，而不是一直等待或者得到broken_promise
     void Callback(std::shared_ptr<std::promise<Json::Value>> result, const BaseMessage::Ptr& msg){
         auto rpc_res = std::dynamic_pointer_cast<RpcResponse>(msg);
         if(!rpc_res){
             LOG_ERROR("rpc响应类型转换失败");
+            result->set_exception(std::make_exception_ptr(std::runtime_error("rpc响应类型转换失败")));
             return;
         }
         if(rpc_res->Rcode() != ResCode::RCODE_OK){
             LOG_ERROR("rpc异步请求出错: {}", GetErrorReason(rpc_res->Rcode()));
+            result->set_exception(std::make_exception_ptr(std::runtime_error(std::string(GetErrorReason(rpc_res->Rcode())))));
             return ;
         }
         result->set_value(rpc_res->Result());
@@ -14,7 +14,7 @@ class RegistryClient{
 public:
     using Ptr = std::shared_ptr<RegistryClient>;
     // 构造函数传入注册中心的地址信息，用于连接注册中心
-    RegistryClient(const std::string& ip, int16_t port)
+    RegistryClient(const std::string& ip, int16_t port, const ClientOptions& options = ClientOptions())
         :_requestor(std::make_shared<Requestor>())
         ,_provider(std::make_shared<Provider>(_requestor)) //这里通过已有requestor构造provider，进行管理
         ,_dispatcher(std::make_shared<Dispatcher>())
@@ -25,13 +25,18 @@ public:
             
             auto message_callback = std::bind(&Dispatcher::OnMessage, _dispatcher.get(), 
                     std::placeholders::_1, std::placeholders::_2);
-            _client = ClientFactory::Create(ip, port);
+            _client = ClientFactory::Create(ip, port, options);
             _client->SetMessageCallBack(message_callback);
+            _client->SetCloseCallBack(std::bind(&Requestor::OnClose, _requestor.get(), std::placeholders::_1));
             _client->Connect();
         }
     // 向外提供的服务注册接口
-    bool RegistryMethod(const std::string& method, const Address& host){
-        return _provider->RegistryMethod(_client->GetConnection(), method, host);
+    bool RegistryMethod(const std::string& method, const Address& host, const LocalEndpoint& endpoint = LocalEndpoint()){
+        return _provider->RegistryMethod(_client->GetConnection(), method, host, endpoint);
+    }
+    // 向外提供的服务注销接口
+    bool UnregistryMethod(const std::string& method, const Address& host){
+        return _provider->UnregistryMethod(_client->GetConnection(), method, host);
     }
 private:
     Requestor::Ptr _requestor;
@@ -44,7 +49,8 @@ class DiscoveryClient{
 public:
     using Ptr = std::shared_ptr<DiscoveryClient>;
     // 构造函数传入发现中心的地址信息，用于连接注册中心
-    DiscoveryClient(const std::string& ip, int16_t port, const Discoverer::OfflineCallback& callback)
+    DiscoveryClient(const std::string& ip, int16_t port, const Discoverer::OfflineCallback& callback,
+                    const ClientOptions& options = ClientOptions())
     :_requestor(std::make_shared<Requestor>())
     ,_discoverer(std::make_shared<Discoverer>(_requestor, callback))
     ,_dispatcher(std::make_shared<Dispatcher>()){
@@ -58,8 +64,9 @@ public:
 
         auto message_callback = std::bind(&Dispatcher::OnMessage, _dispatcher.get(), 
                 std::placeholders::_1, std::placeholders::_2);
-        _client = ClientFactory::Create(ip, port);
+        _client = ClientFactory::Create(ip, port, options);
         _client->SetMessageCallBack(message_callback);
+        _client->SetCloseCallBack(std::bind(&Requestor::OnClose, _requestor.get(), std::placeholders::_1));
         _client->Connect();
     }
     /**
@@ -73,6 +80,15 @@ public:
     bool ServiceDiscovery(const std::string& method, Address& host){
         return _discoverer->ServiceDiscovery(_client->GetConnection(), method, host);
     }
+    bool CachedDiscovery(const std::string& method, Address& host){
+        return _discoverer->CachedDiscovery(method, host);
+    }
+    bool CachedDiscovery(const std::string& method, const Address& exclude, Address& host){
+        return _discoverer->CachedDiscovery(method, exclude, host);
+    }
+    bool HostEndpoint(const Address& host, LocalEndpoint& endpoint){
+        return _discoverer->HostEndpoint(host, endpoint);
+    }
 private:
     Requestor::Ptr _requestor;
     Discoverer::Ptr _discoverer;
@@ -80,6 +96,75 @@ private:
     BaseClient::Ptr _client;
 };
 
+/**
+ * @brief 同一服务提供者的一组连接
+ * @details 每次调用选择未完成请求最少的连接，请求分散到提供者的多个IO线程上，
+ *          大响应只阻塞它所在的那条连接
+ */
+class ClientPool{
+public:
+    using Ptr = std::shared_ptr<ClientPool>;
+    ClientPool(const Requestor::Ptr& requestor):_requestor(requestor), _next(0){}
+    // 只在连接池发布之前调用
+    void Add(const BaseClient::Ptr& client){
+        _clients.push_back(client);
+    }
+    bool Contains(const BaseConnection::Ptr& conn){
+        for(auto& client : _clients){
+            if(client->GetConnection() == conn){
+                return true;
+            }
+        }
+        return false;
+    }
+    // 返回未完成请求最少的客户端，未完成请求数相同时选择心跳往返时延更低的连接，
+    // 正在建立的连接也可以使用(消息排队到连接建立后发送)，全部关闭时返回空
+    BaseClient::Ptr Select(){
+        // 从轮转的起点开始比较，未完成请求数相同时依次使用各连接
+        size_t start = _next.fetch_add(1, std::memory_order_relaxed);
+        BaseClient::Ptr best;
+        size_t best_outstanding = 0;
+        int64_t best_rtt = 0;
+        for(size_t i = 0; i < _clients.size(); ++i){
+            auto& client = _clients[(start + i) % _clients.size()];
+            auto conn = client->GetConnection();
+            if(conn->IsClosed()){
+                continue;
+            }
+            size_t outstanding = _requestor->Outstanding(conn);
+            int64_t rtt = conn->RttUs(); // 未启用心跳时为0，退化为只比较未完成请求数
+            if(best.get() == nullptr || outstanding < best_outstanding ||
+               (outstanding == best_outstanding && rtt < best_rtt)){
+                best = client;
+                best_outstanding = outstanding;
+                best_rtt = rtt;
+            }
+        }
+        return best;
+    }
+    /**
+     * @brief 估计在该服务提供者上再发起一次调用的等待时间：(未完成请求数+1) * 往返时延，取各连接中的最小值
+     * @details 用于在多个服务提供者之间比较负载，没有可用连接时返回最大值
+     */
+    int64_t ExpectedLatencyUs(){
+        int64_t best = std::numeric_limits<int64_t>::max();
+        for(auto& client : _clients){
+            auto conn = client->GetConnection();
+            if(conn->IsClosed()){
+                continue;
+            }
+            int64_t rtt = std::max<int64_t>(conn->RttUs(), 1);
+            int64_t outstanding = static_cast<int64_t>(_requestor->Outstanding(conn));
+            best = std::min(best, (outstanding + 1) * rtt);
+        }
+        return best;
+    }
+private:
+    Requestor::Ptr _requestor;
+    std::vector<BaseClient::Ptr> _clients;
+    std::atomic<size_t> _next; ///< 轮转起点
+};
+
 class RpcClient{
 public:
     using Ptr = std::shared_ptr<RpcClient>;
@@ -89,34 +174,51 @@ public:
          * @param enableDiscovery 是否启用服务发现功能
          * @param ip 
          * @param port 
+         * @param options 底层连接配置，对注册中心与所有服务提供者的连接都生效，
+         *                对每个服务提供者建立 options.connections_per_host 条连接
          * @details 如果启用服务发现，则传入注册中心地址，否则传入服务提供者地址
          */
-    RpcClient(bool enableDiscovery, const std::string& ip, int16_t port)
+    RpcClient(bool enableDiscovery, const std::string& ip, int16_t port, 
+            const ClientOptions& options = ClientOptions())
         :_enable_discovery(enableDiscovery)
+        ,_options(options)
         ,_requestor(std::make_shared<Requestor>())
         ,_dispatcher(std::make_shared<Dispatcher>())
         ,_caller(std::make_shared<RpcCaller>(_requestor))
+        ,_host_name(LocalHostName())
         {
             // 针对Rpc调用
             auto rsp_cb = std::bind(&Requestor::OnResponse, _requestor.get(), 
                     std::placeholders::_1, std::placeholders::_2);
             _dispatcher->RegisterHandler<BaseMessage>(MessType::RESPONSE_RPC, rsp_cb);
+            _requestor->SetFailoverHandler(std::bind(&RpcClient::__Failover, this, std::placeholders::_1,
+                                           std::placeholders::_2, std::placeholders::_3), options.max_failover_retries);
 
             // 如果启用了服务发现，地址信息是注册中心地址信息，是服务发现客户端需要连接的地址，
             // 通过地址信息实例化_discovery_client
             // 如果没有启用服务发现，地址信息是服务提供者的地址信息，则直接实例化rpc_client
             if(_enable_discovery == true){
                 auto offline_callback = std::bind(&RpcClient::__DelClient, this, std::placeholders::_1);
-                _discovery_client = std::make_shared<DiscoveryClient>(ip, port, offline_callback);
+                _discovery_client = std::make_shared<DiscoveryClient>(ip, port, offline_callback, options);
             }
             else{
-                auto message_callback = std::bind(&Dispatcher::OnMessage, _dispatcher.get(), 
-                    std::placeholders::_1, std::placeholders::_2);
-                _rpc_client = ClientFactory::Create(ip, port);
-                _rpc_client->SetMessageCallBack(message_callback);
-                _rpc_client->Connect();
+                _rpc_pool = __CreatePool(Address(ip, port));
             }
         }
+    /**
+     * @brief 先摘掉改发回调，再释放连接池
+     * @details 连接在释放时以断开错误结束其上未完成的请求，此时不能再改发到本对象正在销毁的连接池
+     */
+    ~RpcClient(){
+        _requestor->SetFailoverHandler(Requestor::FailoverHandler());
+        std::unordered_map<Address, ClientPool::Ptr, AddressHash> pools;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            pools.swap(_rpc_clients);
+        }
+        pools.clear();
+        _rpc_pool.reset();
+    }
     // 同步响应
     bool Call(const std::string& method, const Json::Value& params, Json::Value& result){
         // 获取服务提供者： a. 没启用服务发现，去列表查找；b. 启用服务发现，使用固定提供者
@@ -145,15 +247,40 @@ public:
         return _caller->Call(client->GetConnection(), method, params, callback);
     }
 private:
-    BaseClient::Ptr __NewClient(const Address& host){
+    ClientPool::Ptr __CreatePool(const Address& host){
         auto message_callback = std::bind(&Dispatcher::OnMessage, _dispatcher.get(), 
                     std::placeholders::_1, std::placeholders::_2);
-        auto client = ClientFactory::Create(host.first, host.second);
-        client->SetMessageCallBack(message_callback);
-        client->Connect();
+        auto pool = std::make_shared<ClientPool>(_requestor);
+        size_t count = std::max<size_t>(_options.connections_per_host, 1);
+        auto close_callback = std::bind(&Requestor::OnClose, _requestor.get(), std::placeholders::_1);
+        std::string sip = __LocalAddress(host);
+        for(size_t i = 0; i < count; ++i){
+            auto client = ClientFactory::Create(sip, host.second, _options);
+            client->SetMessageCallBack(message_callback);
+            client->SetCloseCallBack(close_callback);
+            // 异步连接：调用不等待连接建立，请求在连接上排队，连接失败或超时时由关闭回调结束
+            client->ConnectAsync();
+            pool->Add(client);
+        }
+        return pool;
+    }
+    // 提供者与本进程在同一主机并监听了unix域套接字时返回 "unix:/path"，否则返回提供者IP
+    // 连接池仍以提供者的TCP地址为键，上下线通知照常匹配
+    std::string __LocalAddress(const Address& host){
+        LocalEndpoint endpoint;
+        if(_enable_discovery && _options.prefer_unix_socket &&
+           _discovery_client->HostEndpoint(host, endpoint) &&
+           _host_name.empty() == false && endpoint.host_name == _host_name){
+            LOG_INFO("服务提供者 {}:{} 在本机, 使用unix域套接字 {}", host.first, host.second, endpoint.unix_path);
+            return UNIX_SCHEME + endpoint.unix_path;
+        }
+        return host.first;
+    }
+    ClientPool::Ptr __NewPool(const Address& host){
+        auto pool = __CreatePool(host);
         // 管理起来
-        __PutClient(host, client);
-        return client;
+        __PutPool(host, pool);
+        return pool;
     }
     BaseClient::Ptr _GetUsefulClient(const std::string& method){
         BaseClient::Ptr client;
@@ -164,28 +291,87 @@ private:
                 LOG_ERROR("当前 {} 服务，没有找到服务提供者！", method);
                 return BaseClient::Ptr();
             }
-            // 2.查看服务提供者是否已有示例化客户端，有则直接使用，没有则创建
-            client = __GetClient(host);
+            // 2.查看服务提供者是否已有连接池，有则直接使用，没有则创建
+            auto pool = __GetPool(host);
+            if(pool.get() == nullptr){
+                pool = __NewPool(host);
+            }
+            // 3.启用心跳时有往返时延可以参考：再取一个已建立连接的服务提供者，两者中选择预计延迟更低的(power of two choices)
+            if(_options.heartbeat_interval_ms > 0){
+                Address other;
+                if(_discovery_client->CachedDiscovery(method, host, other)){
+                    auto other_pool = __GetPool(other);
+                    if(other_pool.get() != nullptr && other_pool->ExpectedLatencyUs() < pool->ExpectedLatencyUs()){
+                        pool = other_pool;
+                        host = other;
+                    }
+                }
+            }
+            client = pool->Select();
             if(client.get() == nullptr){
-                client = __NewClient(host);
+                __DelClient(host); // 连接全部失效，下次调用重新建立
             }
         }
         else{
-            client = _rpc_client;
+            client = _rpc_pool->Select();
+        }
+        if(client.get() == nullptr){
+            LOG_ERROR("当前 {} 服务，服务提供者没有可用连接！", method);
         }
         return client;
     }
-    BaseClient::Ptr __GetClient(const Address& host){
+    /**
+     * @brief 为没有得到结果的请求选择另一个服务提供者的连接
+     * @details 在IO线程中执行，不能同步访问注册中心，只使用本地缓存的服务提供者；
+     *          失败连接所属的提供者可能正在下线或已经失效，总是排除在外，没有其他提供者时返回空。
+     *          连接断开时请求可能已经被处理，只有声明了 failover_on_disconnect 才改发
+     */
+    BaseConnection::Ptr __Failover(const BaseConnection::Ptr& failed, const BaseMessage::Ptr& req, ResCode reason){
+        if(reason == ResCode::RCODE_DISCONNECTED && _options.failover_on_disconnect == false){
+            return BaseConnection::Ptr();
+        }
+        auto rpc_req = std::dynamic_pointer_cast<RpcRequest>(req);
+        if(rpc_req.get() == nullptr || _enable_discovery == false){
+            return BaseConnection::Ptr(); // 未启用服务发现时只有一个服务提供者
+        }
+        Address failed_host, host;
+        __FindHost(failed, failed_host);
+        if(_discovery_client->CachedDiscovery(rpc_req->Method(), failed_host, host) == false){
+            LOG_ERROR("{} 服务没有其他服务提供者, 不再改发", rpc_req->Method());
+            return BaseConnection::Ptr();
+        }
+        auto pool = __GetPool(host);
+        if(pool.get() == nullptr){
+            pool = __NewPool(host);
+        }
+        auto client = pool->Select();
+        if(client.get() == nullptr){
+            return BaseConnection::Ptr();
+        }
+        return client->GetConnection();
+    }
+    ClientPool::Ptr __GetPool(const Address& host){
         std::unique_lock<std::mutex> lock(_mutex);
         auto it = _rpc_clients.find(host);
         if(it == _rpc_clients.end()){
-            return BaseClient::Ptr();
+            return ClientPool::Ptr();
         }
         return it->second;
     }
-    void __PutClient(const Address& host, const BaseClient::Ptr& client){
+    // 查找连接所属的服务提供者，连接池已被删除时返回false
+    bool __FindHost(const BaseConnection::Ptr& conn, Address& host){
+        std::unique_lock<std::mutex> lock(_mutex);
+        for(auto& it : _rpc_clients){
+            if(it.second->Contains(conn)){
+                host = it.first;
+                return true;
+            }
+        }
+        return false;
+    }
+    void __PutPool(const Address& host, const ClientPool::Ptr& pool){
         std::unique_lock<std::mutex> lock(_mutex);
-        _rpc_clients.emplace(host, client);
+        _rpc_clients.emplace(host, pool);
     }
     /**
          * @brief 回调给上层删除，防止泄漏
@@ -193,8 +379,17 @@ private:
          * @param host 
          */
     void __DelClient(const Address& host){
-        std::unique_lock<std::mutex> lock(_mutex);
-        _rpc_clients.erase(host);
+        ClientPool::Ptr pool;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto it = _rpc_clients.find(host);
+            if(it == _rpc_clients.end()){
+                return ;
+            }
+            pool = std::move(it->second);
+            _rpc_clients.erase(it);
+        }
+        // 在锁外释放：连接关闭回调会结束未完成的请求，改发时需要再次访问连接池表
     }
 private:
     /**
@@ -210,18 +405,20 @@ private:
     };
 private:
     bool _enable_discovery;
+    ClientOptions _options;
     Requestor::Ptr _requestor;
     DiscoveryClient::Ptr _discovery_client; ///< 可以进行服务发现
     RpcCaller::Ptr _caller;
     Dispatcher::Ptr _dispatcher;
-    BaseClient::Ptr _rpc_client; //用于未启用服务发现的客户端
+    std::string _host_name; ///< 本机主机名，与提供者上报的主机名比较
+    ClientPool::Ptr _rpc_pool; //用于未启用服务发现的客户端
     std::mutex _mutex;
-    // hash<host, client>
-    std::unordered_map<Address, BaseClient::Ptr, AddressHash> _rpc_clients; ///< 用于启用服务发现后的连接池
+    // hash<host, pool>
+    std::unordered_map<Address, ClientPool::Ptr, AddressHash> _rpc_clients; ///< 用于启用服务发现后的连接池
 };
 class TopicClient{
 public:
-    TopicClient(const std::string &ip, int16_t port)
+    TopicClient(const std::string &ip, int16_t port, const ClientOptions& options = ClientOptions())
         :_requestor(std::make_shared<Requestor>())
         ,_dispatcher(std::make_shared<Dispatcher>())
         ,_topic_manager(std::make_shared<TopicManager>(_requestor)) {
@@ -234,8 +431,9 @@ public:
 
             auto message_cb = std::bind(&Dispatcher::OnMessage, _dispatcher.get(), 
                                         std::placeholders::_1, std::placeholders::_2);
-            _rpc_client = ClientFactory::Create(ip, port);
+            _rpc_client = ClientFactory::Create(ip, port, options);
             _rpc_client->SetMessageCallBack(message_cb);
+            _rpc_client->SetCloseCallBack(std::bind(&Requestor::OnClose, _requestor.get(), std::placeholders::_1));
             _rpc_client->Connect();
         }
     bool Create(const std::string& key){
@@ -2,6 +2,7 @@
 #include "../common/Uuid.hpp"
 #include "Requestor.hpp"
 #include "unordered_set"
+#include <map>
 
 using namespace base;
 
@@ -12,12 +13,15 @@ public:
     Provider():_requestor(std::make_shared<Requestor>()){}
     //这里增加一个直接通过已有requestor构造的接口
     Provider(const std::shared_ptr<Requestor> &requestor): _requestor(requestor) {}
-    bool RegistryMethod(const BaseConnection::Ptr& conn, const std::string& method, const Address& host){
+    // endpoint 非空时随注册信息上报本机端点，同一主机上的客户端可以改走unix域套接字
+    bool RegistryMethod(const BaseConnection::Ptr& conn, const std::string& method, const Address& host,
+                        const LocalEndpoint& endpoint = LocalEndpoint()){
         auto msg_req = MessageFactory::Create<ServiceRequest>();
         msg_req->SetId(Uuid::GetUuid());
         msg_req->SetMessType(MessType::REQUEST_SERVICE);
         msg_req->SetMethod(method);
         msg_req->SetHostMeassage(host);
+        msg_req->SetHostEndpoint(endpoint);
         msg_req->SetServiceOperType(ServiceOperType::SERVICE_REGISRY);
         BaseMessage::Ptr msg_rsp;
         auto ret = _requestor->Send(conn, msg_req, msg_rsp);
@@ -37,6 +41,32 @@ public:
         LOG_INFO("服务注册成功: {}", method);
         return true;
     }
+    // 下线前注销方法，注册中心随即通知发现者，不必等到连接断开
+    bool UnregistryMethod(const BaseConnection::Ptr& conn, const std::string& method, const Address& host){
+        auto msg_req = MessageFactory::Create<ServiceRequest>();
+        msg_req->SetId(Uuid::GetUuid());
+        msg_req->SetMessType(MessType::REQUEST_SERVICE);
+        msg_req->SetMethod(method);
+        msg_req->SetHostMeassage(host);
+        msg_req->SetServiceOperType(ServiceOperType::SERVICE_UNREGISTRY);
+        BaseMessage::Ptr msg_rsp;
+        auto ret = _requestor->Send(conn, msg_req, msg_rsp);
+        if(ret == false){
+            LOG_ERROR("{} 服务注销失败", method);
+            return false;
+        }
+        auto service_rsp = std::dynamic_pointer_cast<ServiceResponse>(msg_rsp);
+        if(service_rsp.get() == nullptr){
+            LOG_ERROR("响应类型向下转型失败!");
+            return false;
+        }
+        if(service_rsp->Rcode() != ResCode::RCODE_OK){
+            LOG_ERROR("服务注销失败, 原因: {}", GetErrorReason(service_rsp->Rcode()));
+            return false;
+        }
+        LOG_INFO("服务注销成功: {}", method);
+        return true;
+    }
 private:
     Requestor::Ptr _requestor;
 };
@@ -57,6 +87,18 @@ public:
         size_t pos = _index++ % _hosts.size(); // RR轮询
         return _hosts[pos];
     }
+    // 与 ChooseHost 一样轮询，但跳过 exclude，没有其他提供者时返回false
+    bool ChooseHost(const Address& exclude, Address& host){
+        std::unique_lock<std::mutex> lock(_mutex);
+        for(size_t i = 0; i < _hosts.size(); ++i){
+            const Address& candidate = _hosts[_index++ % _hosts.size()];
+            if(candidate != exclude){
+                host = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
     void RemoveHost(const Address& host){
         std::unique_lock<std::mutex> lock(_mutex);
         for(auto it = _hosts.begin(); it!=_hosts.end(); ++it){
@@ -127,10 +169,44 @@ public:
         }
         LOG_INFO("从注册中心找到服务提供者： {}", method);
         _method_hosts[method] = method_hosts;
+        auto hosts = service_rsp->Hosts();
+        auto endpoints = service_rsp->HostEndpoints();
+        for(size_t i = 0; i < hosts.size() && i < endpoints.size(); ++i){
+            __SetEndpoint(hosts[i], endpoints[i]);
+        }
 
         host = method_hosts->ChooseHost();
         return true;
     }
+    // 只查本地缓存的服务提供者，不访问注册中心，可以在IO线程中调用
+    bool CachedDiscovery(const std::string& method, Address& host){
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto it = _method_hosts.find(method);
+        if(it == _method_hosts.end() || it->second->Empty()){
+            return false;
+        }
+        host = it->second->ChooseHost();
+        return true;
+    }
+    // 只查本地缓存，选择 exclude 以外的服务提供者，用于把请求改发到另一个提供者
+    bool CachedDiscovery(const std::string& method, const Address& exclude, Address& host){
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto it = _method_hosts.find(method);
+        if(it == _method_hosts.end()){
+            return false;
+        }
+        return it->second->ChooseHost(exclude, host);
+    }
+    // 查询提供者上报的本机端点，没有上报时返回false
+    bool HostEndpoint(const Address& host, LocalEndpoint& endpoint){
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto it = _endpoints.find(host);
+        if(it == _endpoints.end()){
+            return false;
+        }
+        endpoint = it->second;
+        return true;
+    }
     // 提供给Dispatcher模块进行服务上下线请求处理的回调函数
     void OnserviceRequest(const BaseConnection::Ptr& conn, const ServiceRequest::Ptr& msg){
         auto optype = msg->ServiceOperType();
@@ -138,6 +214,7 @@ public:
         std::unique_lock<std::mutex> lock(_mutex);
         if(optype==ServiceOperType::SERVICE_ONLINE){
             // 上线请求
+            __SetEndpoint(msg->HostMeassage(), msg->HostEndpoint());
             auto it = _method_hosts.find(method);
             if(it == _method_hosts.end()){
                 // 没找到，新增地址信息
@@ -157,15 +234,23 @@ public:
                 return ;
             }
             it->second->RemoveHost(msg->HostMeassage());
+            _endpoints.erase(msg->HostMeassage());
             _offline_callback(msg->HostMeassage());
         }
         else{
             LOG_ERROR("错误的服务类型");
         }
     }
+private:
+    // 调用方持有 _mutex
+    void __SetEndpoint(const Address& host, const LocalEndpoint& endpoint){
+        if(endpoint.Empty()) return ;
+        _endpoints[host] = endpoint;
+    }
 private:
     std::mutex _mutex;
     std::unordered_map<std::string, MethodHost::Ptr> _method_hosts;
+    std::map<Address, LocalEndpoint> _endpoints; ///< 上报了本机端点的提供者
     Requestor::Ptr  _requestor;
     OfflineCallback _offline_callback;
 };
@@ -1,12 +1,31 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <functional>
 #include <memory>
+#include <future>
 #include "Fileds.hpp"
 
 namespace base
 {
     using namespace common;
+class BaseBuffer{
+public:
+    using Ptr = std::shared_ptr<BaseBuffer>;
+    virtual ~BaseBuffer() = default;
+    virtual size_t ReadableSize() = 0;
+    virtual int32_t PeekInt32() = 0;
+    virtual void RetrieveInt32() = 0;
+    virtual int32_t ReadInt32() = 0;
+    virtual std::string RetriveAsString(size_t len) = 0;
+    virtual const char* Peek() = 0; ///< 可读区域起始地址，不移动读位置
+    virtual void Retrieve(size_t len) = 0; ///< 丢弃len字节可读数据
+    virtual void Append(const char* data, size_t len) = 0; ///< 追加到可读区域尾部
+    virtual void AppendInt32(int32_t x) = 0; ///< 以网络字节序追加4字节整数
+    virtual void PrependInt32(int32_t x) = 0; ///< 以网络字节序写入可读区域之前的预留区
+    virtual void EnsureWritable(size_t len) = 0; ///< 预留可写空间，之后追加不超过len字节时可读区域不会移动
+};
+
 class BaseMessage{
 public:
     using Ptr = std::shared_ptr<BaseMessage>;
@@ -26,41 +45,181 @@ public:
     virtual std::string Serialize() = 0;
     virtual bool Unserialize(const std::string& msg) = 0;
     virtual bool Check() = 0;
+    /// @brief 直接从缓冲区视图反序列化，默认实现退化为拷贝后调用字符串版本
+    virtual bool Unserialize(std::string_view msg){
+        return Unserialize(std::string(msg));
+    }
+    /// @brief 直接序列化追加到缓冲区，默认实现退化为先生成字符串再追加
+    virtual bool Serialize(BaseBuffer& buffer){
+        std::string body = Serialize();
+        buffer.Append(body.data(), body.size());
+        return true;
+    }
 protected:
     MessType _mtype;
     std::string _rid;
 };
 
-class BaseBuffer{
-public:
-    using Ptr = std::shared_ptr<BaseBuffer>;
-    virtual ~BaseBuffer() = default;
-    virtual size_t ReadableSize() = 0;
-    virtual int32_t PeekInt32() = 0;
-    virtual void RetrieveInt32() = 0;
-    virtual int32_t ReadInt32() = 0;
-    virtual std::string RetriveAsString(size_t len) = 0;
-};
-
 class BaseProtocol{
 public:
     using Ptr = std::shared_ptr<BaseProtocol>;
     virtual ~BaseProtocol() = default;
-    virtual bool CanProcessed(const BaseBuffer::Ptr& buffer) = 0;
-    virtual bool OnMessage(const BaseBuffer::Ptr& buffer, BaseMessage::Ptr& msg) = 0;
+    // 缓冲区以引用传入，调用方可以把缓冲区包装对象放在栈上，不必为每次读事件分配
+    virtual bool CanProcessed(BaseBuffer& buffer) = 0;
+    virtual bool OnMessage(BaseBuffer& buffer, BaseMessage::Ptr& msg) = 0;
     virtual std::string Serialize(const BaseMessage::Ptr& msg) = 0;
+    /// @brief 将一条完整的消息帧直接编码到缓冲区中
+    virtual bool Serialize(const BaseMessage::Ptr& msg, BaseBuffer& buffer) = 0;
+    /// @brief 握手时本端提供的能力位
+    virtual uint32_t OfferedCapabilities() = 0;
+    /// @brief 按对端的协议版本与能力位确定本连接发送时启用的帧特性
+    virtual void Negotiate(uint16_t version, uint32_t capabilities) = 0;
+    /// @brief 协商后的协议版本，0表示对端没有握手(旧版本)
+    virtual uint16_t Version() = 0;
+    /// @brief 发送时启用的能力位，能力位相同的连接编码结果相同，可以共享已编码的帧
+    virtual uint32_t Capabilities() = 0;
+    bool CanProcessed(const BaseBuffer::Ptr& buffer){
+        return CanProcessed(*buffer);
+    }
+    bool OnMessage(const BaseBuffer::Ptr& buffer, BaseMessage::Ptr& msg){
+        return OnMessage(*buffer, msg);
+    }
+};
+/**
+ * @brief 已经编码完成的消息帧，内容不可变，通过引用计数在多个连接间共享
+ * @details 用于同一条消息发送给大量连接的场景(例如主题广播)，消息只需编码一次
+ */
+class EncodedFrame{
+public:
+    using Ptr = std::shared_ptr<const EncodedFrame>;
+    EncodedFrame(std::string&& data):_data(std::move(data)){}
+    const char* Data() const {return _data.data();}
+    size_t Size() const {return _data.size();}
+private:
+    const std::string _data;
 };
+
 class BaseConnection{
 public:
     using Ptr = std::shared_ptr<BaseConnection>;
     virtual ~BaseConnection() = default;
     virtual void Send(const BaseMessage::Ptr& buffer) = 0;
+    /// @brief 按当前连接的协议把消息编码成可共享的帧
+    virtual EncodedFrame::Ptr Encode(const BaseMessage::Ptr& msg) = 0;
+    /// @brief 原样发送已编码的帧，不再重复序列化
+    virtual void Send(const EncodedFrame::Ptr& frame) = 0;
     virtual void Shutdown() = 0;
     virtual bool IsConnected() = 0;
+    /// @brief 连接已关闭且不会再发送数据；正在建立中的连接未连接但也未关闭
+    virtual bool IsClosed(){ return IsConnected() == false; }
+    /// @brief 连接所使用的协议对象，协议内部可能保存该连接的解析状态(例如流式分片)
+    virtual BaseProtocol::Ptr GetProtocol() = 0;
+    /// @brief 已交给连接但尚未写入内核的字节数，可用于慢消费者告警
+    virtual size_t QueuedBytes() = 0;
+    /// @brief 心跳测得的平滑往返时延(微秒)，0表示尚未测量
+    virtual int64_t RttUs(){ return 0; }
 };
 using ConnectionCallBack = std::function<void(const BaseConnection::Ptr&)>;
 using CloseCallBack = std::function<void(const BaseConnection::Ptr&)>;
 using MessageCallBack = std::function<void(const BaseConnection::Ptr&, BaseMessage::Ptr&)>;
+using ConnectDoneCallBack = std::function<void(bool)>;
+
+/**
+ * @brief 消息帧相关配置，服务端与客户端共用
+ */
+struct FrameOptions{
+    size_t max_frame_size = (1<<16); ///< 单个帧的长度上限，超出则断开连接
+    size_t stream_chunk_size = (1<<15); ///< 正文超过该长度时拆成流式分片发送，0表示不分片
+    size_t max_stream_size = (64<<20); ///< 流式消息拼接后的正文长度上限
+    uint32_t capabilities = CAP_STREAMING; ///< 握手时本端提供的能力位(ProtocolCapability)，实际启用的是双方的交集
+    size_t compress_threshold = 4096; ///< 启用 CAP_COMPRESSION 时，正文不小于该长度才压缩，0表示不压缩
+    int compress_level = 1; ///< zlib 压缩级别，1最快
+};
+
+/**
+ * @brief 发送缓冲区超过高水位后的处理策略
+ */
+enum class BackpressurePolicy{
+    PAUSE_READ = 0, ///< 停止读取对端数据，发送缓冲区降到低水位以下后恢复，适合请求-响应类服务
+    DROP, ///< 丢弃新的帧直到降到低水位以下，适合可以容忍丢失的主题广播
+    DISCONNECT, ///< 直接断开连接并释放发送缓冲区
+    DEFAULT ///< 由服务器类型决定：RpcServer/RegistryServer 为 PAUSE_READ，TopicServer 为 DROP；直接使用 ServerFactory 时为 PAUSE_READ
+};
+/**
+ * @brief 连接发送缓冲区的水位控制配置
+ */
+struct BackpressureOptions{
+    size_t high_water_mark = 0; ///< 发送缓冲区高水位(字节)，0表示不限制
+    size_t low_water_mark = 0; ///< 低水位(字节)，PAUSE_READ/DROP 在降到该值以下后恢复
+    BackpressurePolicy policy = BackpressurePolicy::DEFAULT;
+    // 未指定策略时换成服务器类型的默认策略，在各服务器构造时调用
+    void SetDefaultPolicy(BackpressurePolicy fallback){
+        if(policy == BackpressurePolicy::DEFAULT) policy = fallback;
+    }
+};
+
+/**
+ * @brief 共享内存传输配置
+ */
+struct ShmOptions{
+    size_t ring_size = (1<<20); ///< 每个方向的环大小，向上取整为2的幂，由客户端决定
+    int busy_poll_us = 0; ///< 接收环读空之后自旋等待的时间(微秒)，0表示直接通过eventfd等待；自旋期间占用IO线程
+    size_t max_drain_bytes = (256<<10); ///< 一次唤醒最多从接收环取出的字节数，超出后让出IO线程，余下的数据在本轮事件之后继续读取
+};
+
+/**
+ * @brief io_uring 传输配置，每个IO循环一个 io_uring 实例
+ */
+struct UringOptions{
+    unsigned entries = 4096; ///< 提交队列长度，完成队列为其4倍
+    unsigned buffers = 1024; ///< 接收缓冲区数量，同一IO循环上的连接共享，必须是2的幂
+    size_t buffer_size = 8192; ///< 每个接收缓冲区的大小
+};
+
+/**
+ * @brief 服务端配置项
+ * @details 所有字段都带有默认值，默认行为与单Reactor模式一致
+ */
+struct ServerOptions{
+    int io_threads = 0; ///< IO线程数量，0表示所有连接都在主循环上处理，N表示连接分散到N个子循环
+    size_t worker_threads = 0; ///< RpcServer业务线程数量，0表示业务回调直接在IO线程中执行
+    size_t worker_queue_size = 10000; ///< 业务线程池任务队列上限，超出后请求以 RCODE_SERVER_BUSY 拒绝，0表示不限制
+    FrameOptions frame; ///< 消息帧配置
+    bool cork_writes = false; ///< 写合并：一次读事件/一轮事件循环中产生的响应合并为一次写操作
+    int reuse_port_shards = 0; ///< 大于0时启动K个以SO_REUSEPORT绑定同一端口的独立分片，此时忽略io_threads
+    bool pin_shards = true; ///< 分片线程是否绑定到固定CPU核，分片都运行在服务器创建的线程中，调用 Start 的线程不会被绑定
+    bool devirtualize = false; ///< 使用协议与缓冲区类型在编译期确定的服务器(LVMuduoServer)，解析过程不经过虚函数
+    BackpressureOptions backpressure; ///< 每个连接发送缓冲区的水位控制
+    int idle_timeout_s = 0; ///< 连接连续这么多秒没有收到数据即被关闭，0表示不检查；只接收推送的客户端需要定期发送数据
+    std::string unix_path; ///< 非空时额外在该路径上监听unix域套接字，供同一主机上的客户端连接；共享内存服务器与io_uring服务器忽略该项
+    std::string shm_path; ///< 非空时 ServerFactory 创建共享内存服务器，在该unix域套接字路径上接受握手，忽略端口
+    ShmOptions shm; ///< 共享内存传输配置
+    bool io_uring = false; ///< ServerFactory 创建基于io_uring的TCP服务器，此时忽略reuse_port_shards与unix_path
+    UringOptions uring; ///< io_uring 传输配置
+};
+
+/**
+ * @brief 客户端配置项
+ */
+struct ClientOptions{
+    FrameOptions frame; ///< 消息帧配置
+    bool devirtualize = false; ///< 使用协议与缓冲区类型在编译期确定的客户端(LVMuduoClient)
+    size_t connections_per_host = 1; ///< RpcClient 对每个服务提供者建立的连接数
+    int connect_timeout_ms = 3000; ///< 建立连接的超时时间(毫秒)，0表示不超时
+    bool auto_reconnect = false; ///< 连接失败或断开后按指数退避自动重连
+    int reconnect_min_ms = 100; ///< 第一次重连前的等待时间(毫秒)
+    int reconnect_max_ms = 10000; ///< 重连等待时间上限(毫秒)
+    bool failover_on_disconnect = false; ///< RpcClient 在连接断开时把未完成的请求改发到其他服务提供者，只适用于幂等的方法；
+                                         ///< 服务端下线拒绝(RCODE_SERVER_DRAINING)的请求没有被处理，不论该项如何都会改发
+    int max_failover_retries = 1; ///< 一个请求最多改发的次数，0表示不改发
+    bool prefer_unix_socket = true; ///< 服务提供者与RpcClient在同一主机且上报了unix域套接字路径时，改走unix域套接字
+    ShmOptions shm; ///< 地址为 "shm:/path" 时的共享内存传输配置
+    int heartbeat_interval_ms = 0; ///< MuduoClient 发送心跳的间隔(毫秒)，0表示不发送；开启后测量往返时延供选择连接
+    int heartbeat_max_missed = 3; ///< 连续这么多次心跳没有收到应答即认为对端已失效，强制断开连接
+    bool handshake = false; ///< MuduoClient 与 UringClient 连接建立后先发送握手协商帧特性；旧版本服务端不认识握手帧，服务端升级之后再开启
+    bool io_uring = false; ///< TCP地址使用基于io_uring的客户端，不支持自动重连与心跳
+    UringOptions uring; ///< io_uring 传输配置，同一事件循环上的客户端共用第一个创建者的配置
+};
 
 class BaseServer{
 public:
@@ -70,6 +229,14 @@ public:
     virtual void SetCloseCallBack(const CloseCallBack& cb) {_cb_close = cb;}
     virtual void SetMessageCallBack(const MessageCallBack& cb) {_cb_message = cb;}
     virtual void Start() = 0;
+    /**
+     * @brief 停止服务，Start 随之返回
+     * @details 先停止接受新连接，再关闭所有连接的写端，已排队的数据先写完；等待对端关闭连接，最多 flush_timeout_ms 后退出主循环。
+     *          会阻塞调用者，需要在 Start 运行之后、从IO线程以外的线程调用
+     */
+    virtual void Stop(int flush_timeout_ms = 0) = 0;
+    // 所有连接已接受、尚未写入内核的字节数之和，用于告警；在IO线程以外调用时为近似值
+    virtual size_t QueuedBytes() = 0;
 protected:
     ConnectionCallBack _cb_connection;
     CloseCallBack _cb_close;
@@ -83,7 +250,14 @@ public:
     virtual void SetConnectionCallBack(const ConnectionCallBack& cb){_cb_connection = cb;}
     virtual void SetCloseCallBack(const CloseCallBack& cb) {_cb_close = cb;}
     virtual void SetMessageCallBack(const MessageCallBack& cb) {_cb_message = cb;}
+    /// @brief 阻塞等待连接建立，最多等待 ClientOptions::connect_timeout_ms
     virtual void Connect() = 0;
+    /**
+     * @brief 异步建立连接，立即返回
+     * @details 连接建立之前 GetConnection 返回的连接对象即可使用，发送的消息排队到连接建立后写出；
+     *          结果通过返回的future以及cb通知，超时或失败时还会调用关闭回调
+     */
+    virtual std::shared_future<bool> ConnectAsync(const ConnectDoneCallBack& cb = ConnectDoneCallBack()) = 0;
     virtual void Shutdown() = 0;
     virtual bool Send(const BaseMessage::Ptr& msg) = 0;
     virtual bool IsConnected() = 0;
@@ -0,0 +1,111 @@
+#pragma once
+#include <zlib.h>
+#include <ctime>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <endian.h>
+
+namespace common{
+/**
+ * @brief 正文压缩的统计计数，进程内所有连接共享
+ * @details CPU时间取自线程CPU时钟，只统计压缩与解压本身
+ */
+class CompressStats{
+public:
+    static CompressStats& Instance(){
+        static CompressStats stats;
+        return stats;
+    }
+    uint64_t CompressedFrames(){ return _compressed_frames.load(std::memory_order_relaxed); }
+    uint64_t SkippedFrames(){ return _skipped_frames.load(std::memory_order_relaxed); }
+    uint64_t RawBytes(){ return _raw_bytes.load(std::memory_order_relaxed); }
+    uint64_t CompressedBytes(){ return _compressed_bytes.load(std::memory_order_relaxed); }
+    uint64_t CompressCpuNs(){ return _compress_ns.load(std::memory_order_relaxed); }
+    uint64_t DecompressedFrames(){ return _decompressed_frames.load(std::memory_order_relaxed); }
+    uint64_t DecompressCpuNs(){ return _decompress_ns.load(std::memory_order_relaxed); }
+    // 压缩后字节数 / 压缩前字节数，只统计实际压缩发送的帧
+    double Ratio(){
+        uint64_t raw = RawBytes();
+        return raw == 0 ? 1.0 : (double)CompressedBytes() / raw;
+    }
+    void OnCompressed(size_t raw, size_t compressed, uint64_t cpu_ns){
+        _compressed_frames.fetch_add(1, std::memory_order_relaxed);
+        _raw_bytes.fetch_add(raw, std::memory_order_relaxed);
+        _compressed_bytes.fetch_add(compressed, std::memory_order_relaxed);
+        _compress_ns.fetch_add(cpu_ns, std::memory_order_relaxed);
+    }
+    void OnSkipped(uint64_t cpu_ns){
+        _skipped_frames.fetch_add(1, std::memory_order_relaxed);
+        _compress_ns.fetch_add(cpu_ns, std::memory_order_relaxed);
+    }
+    void OnDecompressed(uint64_t cpu_ns){
+        _decompressed_frames.fetch_add(1, std::memory_order_relaxed);
+        _decompress_ns.fetch_add(cpu_ns, std::memory_order_relaxed);
+    }
+private:
+    CompressStats() = default;
+    std::atomic<uint64_t> _compressed_frames{0}; ///< 压缩后发送的帧数
+    std::atomic<uint64_t> _skipped_frames{0}; ///< 超过阈值但压缩后没有变小、按原样发送的帧数
+    std::atomic<uint64_t> _raw_bytes{0}; ///< 压缩帧的原始正文字节数
+    std::atomic<uint64_t> _compressed_bytes{0}; ///< 压缩帧的压缩后正文字节数
+    std::atomic<uint64_t> _compress_ns{0}; ///< 压缩耗费的CPU时间
+    std::atomic<uint64_t> _decompressed_frames{0}; ///< 解压的帧数
+    std::atomic<uint64_t> _decompress_ns{0}; ///< 解压耗费的CPU时间
+};
+
+/**
+ * @brief zlib 正文压缩
+ * @details 压缩结果: |--原始长度(4字节网络序)--|--zlib数据--|，接收端据此一次分配好解压缓冲并限制解压后的大小
+ */
+class Compressor{
+public:
+    // 压缩后没有变小时返回false，调用方按原样发送
+    static bool Compress(const char* data, size_t len, std::string& out, int level = Z_BEST_SPEED){
+        uint64_t begin = __CpuNs();
+        uLongf bound = compressBound(len);
+        out.resize(kLengthPrefix + bound);
+        uint32_t be32 = htobe32(static_cast<uint32_t>(len));
+        ::memcpy(out.data(), &be32, kLengthPrefix);
+        int ret = compress2(reinterpret_cast<Bytef*>(out.data() + kLengthPrefix), &bound,
+                            reinterpret_cast<const Bytef*>(data), len, level);
+        if(ret != Z_OK || kLengthPrefix + bound >= len){
+            CompressStats::Instance().OnSkipped(__CpuNs() - begin);
+            return false;
+        }
+        out.resize(kLengthPrefix + bound);
+        CompressStats::Instance().OnCompressed(len, out.size(), __CpuNs() - begin);
+        return true;
+    }
+    // 数据损坏或解压后超过 max_len 时返回false
+    static bool Decompress(std::string_view data, size_t max_len, std::string& out){
+        if(data.size() < kLengthPrefix){
+            return false;
+        }
+        uint64_t begin = __CpuNs();
+        uint32_t be32 = 0;
+        ::memcpy(&be32, data.data(), kLengthPrefix);
+        size_t len = be32toh(be32);
+        if(len > max_len){
+            return false;
+        }
+        out.resize(len);
+        uLongf out_len = len;
+        int ret = uncompress(reinterpret_cast<Bytef*>(out.data()), &out_len,
+                             reinterpret_cast<const Bytef*>(data.data() + kLengthPrefix), data.size() - kLengthPrefix);
+        if(ret != Z_OK || out_len != len){
+            return false;
+        }
+        CompressStats::Instance().OnDecompressed(__CpuNs() - begin);
+        return true;
+    }
+private:
+    static constexpr size_t kLengthPrefix = 4;
+    static uint64_t __CpuNs(){
+        struct timespec ts;
+        ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+};
+} // namespace common
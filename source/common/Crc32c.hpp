@@ -0,0 +1,117 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define RPC_CRC32C_HAS_SSE42 1
+#endif
+
+namespace common{
+/**
+ * @brief CRC32C(Castagnoli)校验，用于消息帧的校验和
+ * @details x86 CPU 支持 SSE4.2 时使用 crc32 指令，每条指令处理8字节；
+ *          否则使用查表实现(slice-by-8)。两种实现结果一致，运行时检测一次后固定使用其中一种
+ */
+class Crc32c{
+public:
+    // crc 为之前数据的校验值，可以分段计算
+    static uint32_t Compute(const char* data, size_t len, uint32_t crc = 0){
+        static const Function func = HardwareAvailable() ? &Hardware : &Software;
+        return func(data, len, crc);
+    }
+    static bool HardwareAvailable(){
+#ifdef RPC_CRC32C_HAS_SSE42
+        return __builtin_cpu_supports("sse4.2");
+#else
+        return false;
+#endif
+    }
+    static uint32_t Software(const char* data, size_t len, uint32_t crc = 0){
+        const auto& table = __Table();
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+        crc = ~crc;
+        while(len >= 8){
+            uint32_t low = 0, high = 0;
+            ::memcpy(&low, p, 4);
+            ::memcpy(&high, p + 4, 4);
+            low = __ToLittle(low) ^ crc;
+            high = __ToLittle(high);
+            crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^
+                  table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+                  table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^
+                  table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+            p += 8;
+            len -= 8;
+        }
+        while(len-- > 0){
+            crc = table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+#ifdef RPC_CRC32C_HAS_SSE42
+    __attribute__((target("sse4.2")))
+    static uint32_t Hardware(const char* data, size_t len, uint32_t crc = 0){
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+        crc = ~crc;
+#if defined(__x86_64__)
+        uint64_t crc64 = crc;
+        while(len >= 8){
+            uint64_t word = 0;
+            ::memcpy(&word, p, sizeof(word));
+            crc64 = _mm_crc32_u64(crc64, word);
+            p += 8;
+            len -= 8;
+        }
+        crc = static_cast<uint32_t>(crc64);
+#endif
+        while(len >= 4){
+            uint32_t word = 0;
+            ::memcpy(&word, p, sizeof(word));
+            crc = _mm_crc32_u32(crc, word);
+            p += 4;
+            len -= 4;
+        }
+        while(len-- > 0){
+            crc = _mm_crc32_u8(crc, *p++);
+        }
+        return ~crc;
+    }
+#else
+    static uint32_t Hardware(const char* data, size_t len, uint32_t crc = 0){
+        return Software(data, len, crc);
+    }
+#endif
+private:
+    using Function = uint32_t (*)(const char*, size_t, uint32_t);
+    using Table = uint32_t[8][256];
+    static const Table& __Table(){
+        static Table table;
+        static bool inited = [](){
+            const uint32_t poly = 0x82F63B78; // 反射形式的Castagnoli多项式
+            for(uint32_t i = 0; i < 256; ++i){
+                uint32_t crc = i;
+                for(int k = 0; k < 8; ++k){
+                    crc = (crc >> 1) ^ ((crc & 1) ? poly : 0);
+                }
+                table[0][i] = crc;
+            }
+            for(uint32_t i = 0; i < 256; ++i){
+                for(int t = 1; t < 8; ++t){
+                    table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xFF];
+                }
+            }
+            return true;
+        }();
+        (void)inited;
+        return table;
+    }
+    static uint32_t __ToLittle(uint32_t value){
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return __builtin_bswap32(value);
+#else
+        return value;
+#endif
+    }
+};
+} // namespace common
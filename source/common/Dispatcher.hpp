@@ -2,6 +2,7 @@
 #include "Net.hpp"
 #include "Message.hpp"
 #include <functional>
+#include <shared_mutex>
 
 namespace base{
 class Callback{
@@ -23,28 +24,38 @@ public:
 private:
     MessageCallback _handler;
 };
+/**
+ * @brief 消息分发器
+ * @details 处理函数通常在服务端/客户端启动前(构造函数中)注册，启动后映射表基本只读：
+ *          查找只加读锁，多个IO线程/SO_REUSEPORT分片并发分发时互不阻塞；处理函数在锁外执行
+ */
 class Dispatcher{
 public:
     using Ptr = std::shared_ptr<Dispatcher>;
     template<class T>
     void RegisterHandler(const MessType& type, const typename CallbackT<T>::MessageCallback& handler){
-        std::unique_lock<std::mutex> lock(_mutex);
         auto cb = std::make_shared<CallbackT<T>>(handler);
+        std::unique_lock<std::shared_mutex> lock(_mutex);
         _handlers.emplace(type, cb);
     }
     void OnMessage(const BaseConnection::Ptr& conn, BaseMessage::Ptr& msg){
         // 收到消息类型对应的业务处理函数
-        std::unique_lock<std::mutex> lock(_mutex);
-        
-        auto it = _handlers.find(msg->GetMessType());
-        if(it!=_handlers.end()){
-            return it->second->OnMessage(conn, msg);
+        Callback::Ptr cb;
+        {
+            std::shared_lock<std::shared_mutex> lock(_mutex);
+            auto it = _handlers.find(msg->GetMessType());
+            if(it != _handlers.end()){
+                cb = it->second;
+            }
+        }
+        if(cb){
+            return cb->OnMessage(conn, msg);
         }
         LOG_ERROR("收到未知类型的消息!");
         conn->Shutdown();
     }
 private:
-    std::mutex _mutex;
+    std::shared_mutex _mutex;
     std::unordered_map<MessType, Callback::Ptr> _handlers;
 };
 
@@ -2,6 +2,7 @@
 #include <string_view>
 #include <string>
 #include <unordered_map>
+#include <cstdint>
 /*
     消息类型字段
 */
@@ -15,6 +16,8 @@ inline const std::string KEY_OPTYPE = "optype";
 inline const std::string KEY_HOST = "host";
 inline const std::string KEY_HOST_IP = "host_ip";
 inline const std::string KEY_HOST_PORT = "host_port";
+inline const std::string KEY_HOST_NAME = "host_name";
+inline const std::string KEY_HOST_UNIX_PATH = "host_unix_path";
 inline const std::string KEY_RCODE = "rcode";
 inline const std::string KEY_RESULT = "result";
 /* 消息类型 */
@@ -25,6 +28,20 @@ enum class MessType{
     RESPONSE_TOPIC, ///< 主题响应
     REQUEST_SERVICE, ///< 服务请求
     RESPONSE_SERVICE, ///< 服务响应
+    REQUEST_HEARTBEAT, ///< 心跳探测(ping)
+    RESPONSE_HEARTBEAT, ///< 心跳应答(pong)
+    REQUEST_HANDSHAKE, ///< 握手请求：协议版本与本端能力位
+    RESPONSE_HANDSHAKE, ///< 握手应答：协商结果
+};
+
+/* 协议版本，每次帧格式有不兼容的扩展时递增 */
+inline constexpr uint16_t PROTOCOL_VERSION = 1;
+/* 握手协商的能力位：发送端只启用对端声明支持的特性，接收端按帧中的标志位解析 */
+enum ProtocolCapability : uint32_t{
+    CAP_STREAMING = 1u << 0, ///< 大正文拆成流式分片
+    CAP_CHECKSUM = 1u << 1, ///< 帧校验和
+    CAP_COMPRESSION = 1u << 2, ///< 正文压缩
+    CAP_BINARY_CODEC = 1u << 3, ///< 二进制正文编码
 };
 
 /*响应码类型 */
@@ -38,6 +55,8 @@ enum class ResCode{
     RCODE_INVALID_OPTYPE, ///< 无效请求类型
     RCODE_NOT_FOUND_TOPIC, ///< 未找到主题
     RCODE_INTERNAL_ERROR, ///< 内部错误
+    RCODE_SERVER_BUSY, ///< 服务端业务队列已满，请求被拒绝
+    RCODE_SERVER_DRAINING, ///< 服务端正在下线，请求未处理，可以改发到其他服务提供者
 };
 static std::string_view GetErrorReason(ResCode code)
 {
@@ -51,9 +70,11 @@ static std::string_view GetErrorReason(ResCode code)
         {ResCode::RCODE_INVALID_OPTYPE, "Invaild opertor type"},
         {ResCode::RCODE_NOT_FOUND_TOPIC, "Not found right topic"},
         {ResCode::RCODE_INTERNAL_ERROR, "internal error"},
+        {ResCode::RCODE_SERVER_BUSY, "Server busy, request rejected"},
+        {ResCode::RCODE_SERVER_DRAINING, "Server draining, request not processed"},
     };
 
-    if(err_map.contains(code)) return "Invaild error rcode";
+    if(err_map.contains(code) == false) return "Invaild error rcode";
     return err_map[code];
 }
 
@@ -80,6 +101,7 @@ enum class ServiceOperType{
     SERVICE_ONLINE, ///< 服务上线
     SERVICE_OFFLINE, ///< 服务下线
     SERVICE_UNKNOW, 
+    SERVICE_UNREGISTRY, ///< 服务注销(提供者主动下线)，追加在末尾保持已有取值不变
 };
 
 } // namespace base
\ No newline at end of file
@@ -1,42 +1,105 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <memory>
+#include <ostream>
 #include <jsoncpp/json/json.h>
 #include "Logging.hpp"
 
 namespace common{
+/**
+ * @brief 以 std::string 为目标的输出流缓冲，写入的数据直接追加到字符串尾部
+ */
+class StringStreamBuf : public std::streambuf
+{
+public:
+    void Reset(std::string* out){ _out = out; }
+protected:
+    virtual std::streamsize xsputn(const char* s, std::streamsize n) override{
+        _out->append(s, n);
+        return n;
+    }
+    virtual int_type overflow(int_type ch) override{
+        if(traits_type::eq_int_type(ch, traits_type::eof()) == false){
+            _out->push_back(traits_type::to_char_type(ch));
+        }
+        return traits_type::not_eof(ch);
+    }
+private:
+    std::string* _out = nullptr;
+};
+
+/**
+ * @brief JSON正文的序列化与反序列化
+ * @details 读写对象每个线程创建一次之后复用，每条消息不再构造builder、writer/reader与stringstream；
+ *          输出为紧凑格式(无缩进与换行)，任何JSON解析器都能读取，正文比带缩进的格式更短
+ */
 class JsonUtil{
 public:
     static bool Serialize(const Json::Value& value, std::string& body)
     {
-        Json::StreamWriterBuilder Wbuilder;
-        Wbuilder["emitUTF8"] = true;  // 关键配置：输出UTF-8编码的中文
-        std::unique_ptr<Json::StreamWriter> Swriter(Wbuilder.newStreamWriter());
+        body.clear();
+        return Append(value, body);
+    }
+
+    // 追加到 body 尾部，调用方复用同一个字符串时容量足够即不产生分配
+    static bool Append(const Json::Value& value, std::string& body)
+    {
+        WriterContext& ctx = __Writer();
+        ctx.sbuf.Reset(&body);
+        int ret = ctx.writer->write(value, &ctx.os);
+        ctx.sbuf.Reset(nullptr);
+        if(ret != 0)
+        {
+            LOG_ERROR("json serialize failed!");
+            return false;
+        }
+        return true;
+    }
 
-        std::stringstream ss;
-        int ret = Swriter->write(value, &ss);
-        if(ret != 0) 
+    // 直接写入输出流，配合自定义streambuf可以把正文写进网络缓冲区而不产生中间字符串
+    static bool Serialize(const Json::Value& value, std::ostream& os)
+    {
+        int ret = __Writer().writer->write(value, &os);
+        if(ret != 0 || !os)
         {
             LOG_ERROR("json serialize failed!");
             return false;
         }
-        body = ss.str();
         return true;
     }
 
-    static bool UnSerialize(const std::string& body, Json::Value& rvalue)
+    // 参数为视图，可以直接解析网络缓冲区中的数据而无需先拷贝成字符串
+    static bool UnSerialize(std::string_view body, Json::Value& rvalue)
     {
-        Json::CharReaderBuilder CBuilder;
-        CBuilder["emitUTF8"] = true;
-        std::unique_ptr<Json::CharReader> Creader(CBuilder.newCharReader());
+        static thread_local std::unique_ptr<Json::CharReader> Creader(Json::CharReaderBuilder().newCharReader());
 
         std::string error;
-        int ret = Creader->parse(body.c_str(), body.c_str()+body.size(), &rvalue, &error);
-        if(!ret) 
+        int ret = Creader->parse(body.data(), body.data()+body.size(), &rvalue, &error);
+        if(!ret)
         {
             LOG_ERROR("json unserialize failed: {}", error);
             return false;
         }
         return true;
     }
+private:
+    struct WriterContext{
+        WriterContext():os(&sbuf){
+            Json::StreamWriterBuilder Wbuilder;
+            Wbuilder["emitUTF8"] = true;  // 关键配置：输出UTF-8编码的中文
+            Wbuilder["indentation"] = ""; // 紧凑格式
+            writer.reset(Wbuilder.newStreamWriter());
+        }
+        StringStreamBuf sbuf;
+        std::ostream os; ///< 绑定 sbuf，目标字符串每次调用时设置
+        std::unique_ptr<Json::StreamWriter> writer;
+    };
+    // write 期间 writer 持有输出流指针，不可重入；每个线程一份
+    static WriterContext& __Writer()
+    {
+        static thread_local WriterContext ctx;
+        return ctx;
+    }
 }; //class JsonUtil
-} //namespace detail
\ No newline at end of file
+} //namespace detail
@@ -42,7 +42,7 @@ namespace common {
 
 // 核心日志函数，使用C++20格式化和编译期条件判断
 template <LogLevel Level, typename... Args>
-constexpr void Log(std::string_view format, const std::string& file,
+constexpr void Log(std::string_view format, std::string_view file,
                     int line, Args&&... args) {
     // 编译期判断是否需要输出日志，不需要则完全不生成代码
     if constexpr (Level >= DEFAULT_LOG_LEVEL) {
@@ -2,9 +2,34 @@
 #include "Abstract.hpp"
 #include "Fileds.hpp"
 #include "JsonComm.hpp"
+#include <endian.h>
+#include <cstring>
 
 using namespace common;
 namespace base{
+/**
+ * @brief 以 BaseBuffer 为目标的输出流缓冲，写入的数据直接追加到缓冲区可读区域尾部
+ */
+class BufferStreamBuf : public std::streambuf
+{
+public:
+    BufferStreamBuf(BaseBuffer& buffer):_buffer(buffer){}
+protected:
+    virtual std::streamsize xsputn(const char* s, std::streamsize n) override{
+        _buffer.Append(s, n);
+        return n;
+    }
+    virtual int_type overflow(int_type ch) override{
+        if(traits_type::eq_int_type(ch, traits_type::eof()) == false){
+            char c = traits_type::to_char_type(ch);
+            _buffer.Append(&c, 1);
+        }
+        return traits_type::not_eof(ch);
+    }
+private:
+    BaseBuffer& _buffer;
+};
+
 class JsonMessage : public BaseMessage
 {
 public:
@@ -18,9 +43,17 @@ public:
         }
         return body;
     }
+    virtual bool Serialize(BaseBuffer& buffer) override{
+        BufferStreamBuf sbuf(buffer);
+        std::ostream os(&sbuf);
+        return JsonUtil::Serialize(_body, os);
+    }
     virtual bool Unserialize(const std::string& msg) override{
         return JsonUtil::UnSerialize(msg, _body);
     }
+    virtual bool Unserialize(std::string_view msg) override{
+        return JsonUtil::UnSerialize(msg, _body);
+    }
 protected:
     Json::Value _body;
 };
@@ -163,6 +196,15 @@ public:
 };
 
 typedef std::pair<std::string, int16_t> Address;
+/**
+ * @brief 服务提供者的本机端点
+ * @details 提供者同时监听unix域套接字时随注册信息一起上报，与提供者在同一主机上的客户端据此改走unix域套接字
+ */
+struct LocalEndpoint{
+    std::string host_name; ///< 提供者所在主机名
+    std::string unix_path; ///< unix域套接字路径，为空表示没有监听
+    bool Empty() const { return unix_path.empty(); }
+};
 class ServiceRequest : public JsonRequest
 {
 public:
@@ -218,6 +260,20 @@ public:
         val[KEY_HOST_PORT] = addr.second;
         _body[KEY_HOST] = val;
     }
+    // 本机端点是主机信息中的可选字段，需在 SetHostMeassage 之后设置
+    LocalEndpoint HostEndpoint(){
+        LocalEndpoint endpoint;
+        if(_body[KEY_HOST].isObject()){
+            endpoint.host_name = _body[KEY_HOST].get(KEY_HOST_NAME, "").asString();
+            endpoint.unix_path = _body[KEY_HOST].get(KEY_HOST_UNIX_PATH, "").asString();
+        }
+        return endpoint;
+    }
+    void SetHostEndpoint(const LocalEndpoint& endpoint){
+        if(endpoint.Empty()) return ;
+        _body[KEY_HOST][KEY_HOST_NAME] = endpoint.host_name;
+        _body[KEY_HOST][KEY_HOST_UNIX_PATH] = endpoint.unix_path;
+    }
 };
 
 class ServiceResponse : public JsonResponse
@@ -257,11 +313,16 @@ public:
     void SetMethod(const std::string& method){
         _body[KEY_METHOD] = method;
     }
-    void SetHosts(const std::vector<Address>& addrs){
-        for(const auto& addr : addrs){
+    // endpoints 为空或与 addrs 一一对应
+    void SetHosts(const std::vector<Address>& addrs, const std::vector<LocalEndpoint>& endpoints = {}){
+        for(size_t i = 0; i < addrs.size(); ++i){
             Json::Value val;
-            val[KEY_HOST_IP] = addr.first;
-            val[KEY_HOST_PORT] = addr.second;
+            val[KEY_HOST_IP] = addrs[i].first;
+            val[KEY_HOST_PORT] = addrs[i].second;
+            if(i < endpoints.size() && endpoints[i].Empty() == false){
+                val[KEY_HOST_NAME] = endpoints[i].host_name;
+                val[KEY_HOST_UNIX_PATH] = endpoints[i].unix_path;
+            }
             _body[KEY_HOST].append(val);
         }
     }
@@ -276,6 +337,18 @@ public:
         }
         return addrs;
     }
+    // 与 Hosts() 一一对应，没有上报本机端点的提供者对应空端点
+    std::vector<LocalEndpoint> HostEndpoints(){
+        std::vector<LocalEndpoint> endpoints;
+        int size = _body[KEY_HOST].size();
+        for(int i=0; i<size ; i++){
+            LocalEndpoint endpoint;
+            endpoint.host_name = _body[KEY_HOST][i].get(KEY_HOST_NAME, "").asString();
+            endpoint.unix_path = _body[KEY_HOST][i].get(KEY_HOST_UNIX_PATH, "").asString();
+            endpoints.emplace_back(endpoint);
+        }
+        return endpoints;
+    }
     common::ServiceOperType ServiceOperType(){
         return static_cast<common::ServiceOperType>(_body[KEY_OPTYPE].asInt());
     }
@@ -283,6 +356,116 @@ public:
         _body[KEY_OPTYPE] = static_cast<int>(optype);
     }
 };
+/**
+ * @brief 心跳消息
+ * @details 正文是8字节网络字节序的发送时间(微秒)，不经过JSON；应答原样带回该时间，发送端据此计算往返时延。
+ *          时间只在发送端内部比较，对端不解释它的含义
+ */
+class HeartbeatMessage : public BaseMessage
+{
+public:
+    using Ptr = std::shared_ptr<HeartbeatMessage>;
+    HeartbeatMessage():_timestamp_us(0){}
+    virtual std::string Serialize() override{
+        uint64_t be64 = htobe64(_timestamp_us);
+        return std::string(reinterpret_cast<const char*>(&be64), sizeof(be64));
+    }
+    virtual bool Serialize(BaseBuffer& buffer) override{
+        uint64_t be64 = htobe64(_timestamp_us);
+        buffer.Append(reinterpret_cast<const char*>(&be64), sizeof(be64));
+        return true;
+    }
+    virtual bool Unserialize(const std::string& msg) override{
+        return Unserialize(std::string_view(msg));
+    }
+    virtual bool Unserialize(std::string_view msg) override{
+        if(msg.size() != sizeof(uint64_t)){
+            LOG_ERROR("心跳消息长度错误: {}", msg.size());
+            return false;
+        }
+        uint64_t be64 = 0;
+        ::memcpy(&be64, msg.data(), sizeof(be64));
+        _timestamp_us = be64toh(be64);
+        return true;
+    }
+    virtual bool Check() override{
+        return true;
+    }
+    uint64_t Timestamp(){
+        return _timestamp_us;
+    }
+    void SetTimestamp(uint64_t timestamp_us){
+        _timestamp_us = timestamp_us;
+    }
+private:
+    uint64_t _timestamp_us;
+};
+
+/**
+ * @brief 握手消息，连接建立后由客户端首先发出，服务端应答协商结果
+ * @details 正文固定8字节(网络序): |--version(2)--|--reserved(2)--|--capabilities(4)--|，不经过JSON
+ */
+class HandshakeMessage : public BaseMessage
+{
+public:
+    using Ptr = std::shared_ptr<HandshakeMessage>;
+    HandshakeMessage():_version(0), _capabilities(0){}
+    virtual std::string Serialize() override{
+        char body[kBodyLength];
+        __Encode(body);
+        return std::string(body, sizeof(body));
+    }
+    virtual bool Serialize(BaseBuffer& buffer) override{
+        char body[kBodyLength];
+        __Encode(body);
+        buffer.Append(body, sizeof(body));
+        return true;
+    }
+    virtual bool Unserialize(const std::string& msg) override{
+        return Unserialize(std::string_view(msg));
+    }
+    virtual bool Unserialize(std::string_view msg) override{
+        if(msg.size() != kBodyLength){
+            LOG_ERROR("握手消息长度错误: {}", msg.size());
+            return false;
+        }
+        uint16_t be16 = 0;
+        uint32_t be32 = 0;
+        ::memcpy(&be16, msg.data(), sizeof(be16));
+        ::memcpy(&be32, msg.data() + 4, sizeof(be32));
+        _version = be16toh(be16);
+        _capabilities = be32toh(be32);
+        return true;
+    }
+    virtual bool Check() override{
+        return true;
+    }
+    uint16_t Version(){
+        return _version;
+    }
+    void SetVersion(uint16_t version){
+        _version = version;
+    }
+    uint32_t Capabilities(){
+        return _capabilities;
+    }
+    void SetCapabilities(uint32_t capabilities){
+        _capabilities = capabilities;
+    }
+private:
+    static constexpr size_t kBodyLength = 8;
+    void __Encode(char* body){
+        uint16_t be16 = htobe16(_version);
+        uint32_t be32 = htobe32(_capabilities);
+        ::memset(body, 0, kBodyLength);
+        ::memcpy(body, &be16, sizeof(be16));
+        ::memcpy(body + 4, &be32, sizeof(be32));
+    }
+private:
+    uint16_t _version;
+    uint32_t _capabilities;
+};
+
 /* 工厂模式生产对象 */
 class MessageFactory{
 public:
@@ -301,6 +484,12 @@ public:
             return std::make_shared<ServiceRequest>();
         case MessType::RESPONSE_SERVICE : 
             return std::make_shared<ServiceResponse>();
+        case MessType::REQUEST_HEARTBEAT : 
+        case MessType::RESPONSE_HEARTBEAT : 
+            return std::make_shared<HeartbeatMessage>();
+        case MessType::REQUEST_HANDSHAKE : 
+        case MessType::RESPONSE_HANDSHAKE : 
+            return std::make_shared<HandshakeMessage>();
         default:
             return BaseMessage::Ptr();
         }
@@ -8,13 +8,26 @@
 #include <muduo/net/TcpClient.h>
 #include <muduo/net/EventLoopThread.h>
 #include <mutex>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <pthread.h>
+#include <netinet/tcp.h>
 #include <unordered_map>
+#include <concepts>
+#include <type_traits>
 #include "Fileds.hpp"
 #include "Abstract.hpp"
 #include "Message.hpp"
+#include "UnixSocket.hpp"
+#include "ShmRing.hpp"
+#include "Crc32c.hpp"
+#include "Compress.hpp"
+#include "Uring.hpp"
 
 namespace base{
-class MuduoBuffer : public BaseBuffer{
+class MuduoBuffer final : public BaseBuffer{
 public:
     using Ptr = std::shared_ptr<MuduoBuffer>;
     MuduoBuffer(muduo::net::Buffer* buf):_buf(buf){}
@@ -36,6 +49,24 @@ public:
     virtual std::string RetriveAsString(size_t len) override{
         return _buf->retrieveAsString(len);
     }
+    virtual const char* Peek() override{
+        return _buf->peek();
+    }
+    virtual void Retrieve(size_t len) override{
+        _buf->retrieve(len);
+    }
+    virtual void Append(const char* data, size_t len) override{
+        _buf->append(data, len);
+    }
+    virtual void AppendInt32(int32_t x) override{ // 主机字节序转网络字节序后追加
+        _buf->appendInt32(x);
+    }
+    virtual void PrependInt32(int32_t x) override{ // 写入readerIndex之前的预留区(kCheapPrepend)
+        _buf->prependInt32(x);
+    }
+    virtual void EnsureWritable(size_t len) override{
+        _buf->ensureWritableBytes(len);
+    }
 private:
     muduo::net::Buffer* _buf;
 };
@@ -47,36 +78,341 @@ public:
         return std::make_shared<MuduoBuffer>(std::forward<Args>(args)...); /// 这里的... 是展开参数包的意思
     }
 };
+// 具体的缓冲区类型：派生自BaseBuffer但不是BaseBuffer本身
+template<typename T>
+concept ConcreteBuffer = std::derived_from<T, BaseBuffer> && !std::is_same_v<T, BaseBuffer>;
 
-class LVProtocol : public BaseProtocol{
+class LVProtocol final : public BaseProtocol{
 public:
 //  |--len--|--value--|
 //  |--len--|--mtype--|--id_len--|--id--|--body--|
+//  mtype 字段低16位为消息类型，高位为帧标志位:
+//  大于 stream_chunk_size 的正文被拆成多个流式分片帧发送，每个分片帧都带有 kStreamFlag，
+//  最后一个分片额外带有 kStreamEndFlag，接收端逐帧拼接正文，收齐后再反序列化
+//  心跳帧的正文是8字节网络序的发送时间(id为空)，不经过JSON，整帧只有20字节
+//  握手帧由客户端在连接建立后首先发出，双方能力位的交集决定各自发送时启用的帧特性；
+//  帧特性都由 mtype 标志位自描述，接收端不依赖协商结果解析，握手前后的帧可以混在一起
+//  协商了 CAP_CHECKSUM 时帧带有 kChecksumFlag，末尾追加4字节CRC32C(覆盖mtype到正文):
+//  |--len--|--mtype--|--id_len--|--id--|--body--|--crc32c--|，校验失败的帧被丢弃，连接保持
+//  协商了 CAP_COMPRESSION 时，不小于 compress_threshold 的正文用zlib压缩，帧带有 kCompressFlag；
+//  先压缩再分片，流式消息的每个分片都带有该标志，收齐后整体解压
     using Ptr = std::shared_ptr<LVProtocol>;
+    using BaseProtocol::CanProcessed;
+    using BaseProtocol::OnMessage;
+    using BaseProtocol::Serialize;
+    LVProtocol(const FrameOptions& options = FrameOptions())
+    :_options(options), _version(0), _capabilities(options.capabilities & kLegacyCapabilities)
+    {}
     virtual ~LVProtocol() = default;
     // 判断缓冲区中的数量是否足够一条消息的处理
-    virtual bool CanProcessed(const BaseBuffer::Ptr& buffer) override{
-        if(buffer->ReadableSize() < lenFieldsLength){
+    virtual bool CanProcessed(BaseBuffer& buffer) override{
+        return __CanProcessed(buffer);
+    }
+    // 返回true但msg为空，表示收到的是一个流式分片，完整消息尚未拼接完成
+    virtual bool OnMessage(BaseBuffer& buffer, BaseMessage::Ptr& msg) override{
+        return __OnMessage(buffer, msg);
+    }
+    // 字符串编码接口不做分片
+    virtual std::string Serialize(const BaseMessage::Ptr& msg) override{
+    //  |--len--|--mtype--|--id_len--|--id--|--body--|
+        std::string body = msg->Serialize();
+        std::string id = msg->Rid();
+        bool checksum = Capabilities() & CAP_CHECKSUM;
+        int32_t flags = checksum ? kChecksumFlag : 0;
+        if(__CompressBody(body.data(), body.size(), body)){
+            flags |= kCompressFlag;
+        }
+        // 字节序转换
+        auto mtype = htonl((int32_t)msg->GetMessType() | flags); 
+        auto id_len = htonl(id.size());
+        auto h_total_len = mtypeFieldsLength + idLenFieldsLength + id.size() + body.size() + (checksum ? checksumLength : 0);
+        if(h_total_len > kMaxFieldLength){
+            LOG_ERROR("消息帧长度 {} 超过长度字段的表示范围", h_total_len);
+            return std::string();
+        }
+        auto nl_total_len = htonl(h_total_len);
+        std::string result;
+        result.reserve(lenFieldsLength + h_total_len);
+        result.append((char*)&nl_total_len, lenFieldsLength);
+        result.append((char*)&mtype, mtypeFieldsLength);
+        result.append((char*)&id_len, idLenFieldsLength);
+        result.append(id);
+        result.append(body);
+        if(checksum){
+            auto crc = htonl(Crc32c::Compute(result.data() + lenFieldsLength, result.size() - lenFieldsLength));
+            result.append((char*)&crc, checksumLength);
+        }
+        return result;
+    }
+    // 校验失败被丢弃的帧数
+    size_t ChecksumErrors(){
+        return _checksum_errors;
+    }
+    virtual bool Serialize(const BaseMessage::Ptr& msg, BaseBuffer& buffer) override{
+        return __Serialize(msg, buffer);
+    }
+    /**
+     * @brief 以具体缓冲区类型调用的非虚接口
+     * @details 缓冲区类型在编译期确定时，解析与编码过程中对缓冲区的调用都是直接调用，可以被内联；
+     *          以 BaseBuffer 调用时匹配上面的虚接口
+     */
+    template<ConcreteBuffer BufferT>
+    bool CanProcessed(BufferT& buffer){
+        return __CanProcessed(buffer);
+    }
+    template<ConcreteBuffer BufferT>
+    bool OnMessage(BufferT& buffer, BaseMessage::Ptr& msg){
+        return __OnMessage(buffer, msg);
+    }
+    template<ConcreteBuffer BufferT>
+    bool Serialize(const BaseMessage::Ptr& msg, BufferT& buffer){
+        return __Serialize(msg, buffer);
+    }
+    virtual uint32_t OfferedCapabilities() override{
+        return _options.capabilities & kSupportedCapabilities;
+    }
+    // 在连接的IO线程中调用，编码可能发生在业务线程，因此协商结果以原子变量保存
+    virtual void Negotiate(uint16_t version, uint32_t capabilities) override{
+        _version.store(std::min(version, PROTOCOL_VERSION), std::memory_order_relaxed);
+        _capabilities.store(OfferedCapabilities() & capabilities, std::memory_order_relaxed);
+    }
+    virtual uint16_t Version() override{
+        return _version.load(std::memory_order_relaxed);
+    }
+    virtual uint32_t Capabilities() override{
+        return _capabilities.load(std::memory_order_relaxed);
+    }
+private:
+    template<typename BufferT>
+    bool __CanProcessed(BufferT& buffer){
+        if(buffer.ReadableSize() < lenFieldsLength){
             return false;
         }
-        int32_t total_len = buffer->PeekInt32();
-        if(buffer->ReadableSize() < (total_len + lenFieldsLength)){
+        int32_t total_len = buffer.PeekInt32();
+        // 以size_t计算帧长度，长度字段接近INT32_MAX时加上长度字段本身不会溢出
+        if(total_len < 0 || (size_t)total_len + lenFieldsLength > _options.max_frame_size){
+            return true; // 长度字段非法或超过帧长度上限，不必等待数据收齐，交给 OnMessage 报错
+        }
+        if(buffer.ReadableSize() < (size_t)total_len + lenFieldsLength){
             return false;
         }
         return true;
     }
-    virtual bool OnMessage(const BaseBuffer::Ptr& buffer, BaseMessage::Ptr& msg) override{
+    template<typename BufferT>
+    bool __OnMessage(BufferT& buffer, BaseMessage::Ptr& msg){
         // 调用此函数时，默认认为缓冲区中的数据足够一条完整的消息
-        int32_t total_len = buffer->ReadInt32(); //读取总长度
-        MessType mytype = (MessType)buffer->ReadInt32();  // 读取数据类型
-        int32_t id_len = buffer->ReadInt32();  // 读取id长度
-        int32_t body_len = total_len - id_len - idLenFieldsLength - mtypeFieldsLength;
-
-        std::string id = buffer->RetriveAsString(id_len);
-        std::string body = buffer->RetriveAsString(body_len);
+        // 直接在缓冲区可读区域上解析：id与正文都以视图形式引用，解析完成后再整体移除这条消息
+        msg.reset();
+        const char* data = buffer.Peek();
+        int32_t total_len = __PeekInt32(data); //读取总长度
+        int32_t mtype_field = __PeekInt32(data + lenFieldsLength);  // 读取数据类型及标志位
+        int32_t id_len = __PeekInt32(data + lenFieldsLength + mtypeFieldsLength);  // 读取id长度
+        // 长度字段来自对端，以64位计算，任意取值都不会溢出
+        int64_t body_len = (int64_t)total_len - id_len - idLenFieldsLength - mtypeFieldsLength;
+        if(mtype_field & kChecksumFlag){
+            body_len -= checksumLength;
+        }
+        if(total_len < 0 || id_len < 0 || body_len < 0){
+            LOG_ERROR("消息长度字段错误!");
+            return false;
+        }
+        size_t frame_len = lenFieldsLength + (size_t)total_len;
+        if(frame_len > _options.max_frame_size){
+            LOG_ERROR("消息帧长度 {} 超过上限 {}", frame_len, _options.max_frame_size);
+            return false;
+        }
+        if(mtype_field & ~(kTypeMask | kKnownFlags)){
+            LOG_ERROR("消息帧带有不支持的标志位: {:#x}", (uint32_t)mtype_field);
+            return false;
+        }
+        if(mtype_field & kChecksumFlag){
+            // 校验值覆盖 mtype 到正文，不一致说明帧在传输中被破坏：只丢弃这一帧，长度字段仍然可信时后续帧照常解析
+            uint32_t expect = (uint32_t)__PeekInt32(data + frame_len - checksumLength);
+            uint32_t actual = Crc32c::Compute(data + lenFieldsLength, total_len - checksumLength);
+            if(expect != actual){
+                ++_checksum_errors;
+                LOG_ERROR("消息帧校验失败(期望 {:#x}, 实际 {:#x}), 丢弃该帧", expect, actual);
+                if(mtype_field & kStreamFlag){
+                    _stream = StreamContext(); // 流式消息已不完整，放弃拼接
+                    _stream.discard = (mtype_field & kStreamEndFlag) == 0;
+                }
+                buffer.Retrieve(frame_len);
+                return true;
+            }
+        }
+        MessType mytype = (MessType)(mtype_field & kTypeMask);
+        std::string_view id(data + headerLength, id_len);
+        std::string_view body(data + headerLength + id_len, (size_t)body_len);
 
+        if(_stream.discard){
+            // 丢弃已损坏的流式消息余下的分片，直到该消息的最后一个分片
+            if(mtype_field & kStreamFlag){
+                _stream.discard = (mtype_field & kStreamEndFlag) == 0;
+                buffer.Retrieve(frame_len);
+                return true;
+            }
+            _stream.discard = false;
+        }
+        if(mtype_field & kStreamFlag){
+            bool ret = __OnStreamChunk(mytype, id, body, mtype_field & kStreamEndFlag, mtype_field & kCompressFlag);
+            buffer.Retrieve(frame_len);
+            if(ret == false || _stream.finished == false){
+                return ret;
+            }
+            // 分片已收齐，从拼接好的正文构造消息
+            ret = __BuildMessage(_stream.mtype, _stream.id, _stream.body, msg, _stream.compressed);
+            _stream = StreamContext(); // 释放拼接缓冲
+            return ret;
+        }
+        bool ret = __BuildMessage(mytype, id, body, msg, mtype_field & kCompressFlag);
+        buffer.Retrieve(frame_len);
+        return ret;
+    }
+    template<typename BufferT>
+    bool __Serialize(const BaseMessage::Ptr& msg, BufferT& buffer){
+    //  |--len--|--mtype--|--id_len--|--id--|--body--|
+        // 要求传入空缓冲区：mtype、id_len、id 与正文依次追加，
+        // 正文写完后总长度才确定，此时把 len 字段写入缓冲区头部的预留区，整个过程没有中间字符串
+        std::string id = msg->Rid();
+        if(id.size() > kMaxFieldLength){
+            LOG_ERROR("消息id长度 {} 超过上限", id.size());
+            return false;
+        }
+        bool checksum = Capabilities() & CAP_CHECKSUM;
+        buffer.AppendInt32((int32_t)msg->GetMessType() | (checksum ? kChecksumFlag : 0));
+        buffer.AppendInt32(id.size());
+        buffer.Append(id.data(), id.size());
+        if(msg->Serialize(buffer) == false){
+            LOG_ERROR("消息正文序列化失败!");
+            return false;
+        }
+        size_t header_len = mtypeFieldsLength + idLenFieldsLength + id.size();
+        size_t body_len = buffer.ReadableSize() - header_len;
+        bool streaming = (Capabilities() & CAP_STREAMING) && _options.stream_chunk_size > 0;
+        std::string compressed;
+        bool compress = __CompressBody(buffer.Peek() + header_len, body_len, compressed);
+        int32_t mtype_field = (int32_t)msg->GetMessType() | (compress ? kCompressFlag : 0);
+        if(compress == false && streaming && body_len > _options.stream_chunk_size){
+            // 大正文：分片帧追加在未分片的帧之后，正文直接从缓冲区中读取，写完后丢弃前面未分片的帧。
+            // 先预留全部分片的空间，追加过程中正文所在的可读区域不会移动
+            buffer.EnsureWritable(__ChunkedSize(id.size(), body_len, checksum));
+            if(__SerializeChunks(mtype_field, id, buffer.Peek() + header_len, body_len, buffer, checksum) == false){
+                buffer.Retrieve(buffer.ReadableSize());
+                return false;
+            }
+            buffer.Retrieve(header_len + body_len);
+            return true;
+        }
+        if(compress){
+            // 压缩后的正文重新组帧
+            buffer.Retrieve(buffer.ReadableSize());
+            if(streaming && compressed.size() > _options.stream_chunk_size){
+                return __SerializeChunks(mtype_field, id, compressed.data(), compressed.size(), buffer, checksum);
+            }
+            buffer.AppendInt32(mtype_field | (checksum ? kChecksumFlag : 0));
+            buffer.AppendInt32(id.size());
+            buffer.Append(id.data(), id.size());
+            buffer.Append(compressed.data(), compressed.size());
+        }
+        if(buffer.ReadableSize() + (checksum ? checksumLength : 0) > kMaxFieldLength){
+            LOG_ERROR("消息帧长度 {} 超过长度字段的表示范围", buffer.ReadableSize());
+            buffer.Retrieve(buffer.ReadableSize());
+            return false;
+        }
+        if(checksum){
+            buffer.AppendInt32((int32_t)Crc32c::Compute(buffer.Peek(), buffer.ReadableSize()));
+        }
+        buffer.PrependInt32(buffer.ReadableSize());
+        return true;
+    }
+    // 流式分片拼接上下文，同一连接上分片不会交错，因此只需要一个
+    struct StreamContext{
+        bool active = false;
+        bool finished = false;
+        bool discard = false; ///< 有分片校验失败，丢弃该消息余下的分片
+        bool compressed = false; ///< 拼接后的正文需要解压
+        MessType mtype;
+        std::string id;
+        std::string body;
+    };
+    bool __OnStreamChunk(MessType mtype, std::string_view id, std::string_view chunk, bool last, bool compressed){
+        if(_stream.active == false){
+            _stream.active = true;
+            _stream.compressed = compressed;
+            _stream.mtype = mtype;
+            _stream.id.assign(id.data(), id.size());
+        }
+        else if(_stream.mtype != mtype || _stream.id != id){
+            LOG_ERROR("流式分片交错, 当前消息 '{}', 收到分片 '{}'", _stream.id, id);
+            return false;
+        }
+        if(_stream.body.size() + chunk.size() > _options.max_stream_size){
+            LOG_ERROR("流式消息 '{}' 超过上限 {} 字节", _stream.id, _options.max_stream_size);
+            return false;
+        }
+        _stream.body.append(chunk.data(), chunk.size());
+        _stream.finished = last;
+        return true;
+    }
+    // 分片帧中除分片正文以外的字节数
+    static size_t __ChunkOverhead(size_t id_len, bool checksum){
+        return headerLength + id_len + (checksum ? checksumLength : 0);
+    }
+    size_t __ChunkedSize(size_t id_len, size_t body_len, bool checksum){
+        size_t chunks = (body_len + _options.stream_chunk_size - 1) / _options.stream_chunk_size;
+        return body_len + chunks * __ChunkOverhead(id_len, checksum);
+    }
+    // body 可以指向 buffer 的可读区域，调用方需要事先预留全部分片的空间
+    template<typename BufferT>
+    bool __SerializeChunks(int32_t mtype_flags, const std::string& id, const char* body, size_t body_len, BufferT& buffer, bool checksum){
+        if(__ChunkOverhead(id.size(), checksum) - lenFieldsLength + _options.stream_chunk_size > kMaxFieldLength){
+            LOG_ERROR("分片长度 {} 超过长度字段的表示范围", _options.stream_chunk_size);
+            return false;
+        }
+        size_t offset = 0;
+        while(offset < body_len){
+            size_t chunk_len = std::min(_options.stream_chunk_size, body_len - offset);
+            int32_t mtype_field = mtype_flags | kStreamFlag | (checksum ? kChecksumFlag : 0);
+            if(offset + chunk_len == body_len){
+                mtype_field |= kStreamEndFlag;
+            }
+            size_t start = buffer.ReadableSize();
+            buffer.AppendInt32(__ChunkOverhead(id.size(), checksum) - lenFieldsLength + chunk_len);
+            buffer.AppendInt32(mtype_field);
+            buffer.AppendInt32(id.size());
+            buffer.Append(id.data(), id.size());
+            buffer.Append(body + offset, chunk_len);
+            if(checksum){
+                size_t covered = start + lenFieldsLength;
+                buffer.AppendInt32((int32_t)Crc32c::Compute(buffer.Peek() + covered, buffer.ReadableSize() - covered));
+            }
+            offset += chunk_len;
+        }
+        return true;
+    }
+    // 协商了压缩且正文不小于阈值时压缩到out，压缩后没有变小则返回false按原样发送
+    bool __CompressBody(const char* body, size_t len, std::string& out){
+        if((Capabilities() & CAP_COMPRESSION) == 0 || _options.compress_threshold == 0 || len < _options.compress_threshold){
+            return false;
+        }
+        std::string compressed;
+        if(Compressor::Compress(body, len, compressed, _options.compress_level) == false){
+            return false;
+        }
+        out.swap(compressed);
+        return true;
+    }
+    bool __BuildMessage(MessType mtype, std::string_view id, std::string_view body, BaseMessage::Ptr& msg, bool compressed = false){
+        std::string plain;
+        if(compressed){
+            if(Compressor::Decompress(body, _options.max_stream_size, plain) == false){
+                LOG_ERROR("消息 '{}' 正文解压失败!", id);
+                return false;
+            }
+            body = plain;
+        }
         // 构造对象
-        msg = MessageFactory::Create(mytype);
+        msg = MessageFactory::Create(mtype);
         if(msg.get() == nullptr){
             LOG_ERROR("消息类型错误， 构造消息对象失败!");
             return false;
@@ -84,36 +420,40 @@ public:
         bool ret = msg->Unserialize(body);
         if(ret == false){
             LOG_ERROR("消息正文反序列化失败!");
+            msg.reset();
             return false;
         }
-
-        msg->SetId(id);
-        msg->SetMessType(mytype);
+        msg->SetId(std::string(id));
+        msg->SetMessType(mtype);
         LOG_DEBUG("消息构造成功");
         return true;
     }
-    virtual std::string Serialize(const BaseMessage::Ptr& msg) override{
-    //  |--len--|--mtype--|--id_len--|--id--|--body--|
-        std::string body = msg->Serialize();
-        std::string id = msg->Rid();
-        // 字节序转换
-        auto mtype = htonl((int32_t)msg->GetMessType()); 
-        auto id_len = htonl(id.size());
-        auto h_total_len = mtypeFieldsLength + idLenFieldsLength + id.size() + body.size();
-        auto nl_total_len = htonl(h_total_len);
-        std::string result;
-        result.reserve(h_total_len);
-        result.append((char*)&nl_total_len, lenFieldsLength);
-        result.append((char*)&mtype, mtypeFieldsLength);
-        result.append((char*)&id_len, idLenFieldsLength);
-        result.append(id);
-        result.append(body);
-        return result;
+    // 从任意地址读取一个网络字节序的4字节整数
+    static int32_t __PeekInt32(const char* data){
+        int32_t be32 = 0;
+        ::memcpy(&be32, data, sizeof(be32));
+        return ntohl(be32);
     }
 private:
     static const int32_t lenFieldsLength = 4;
     static const int32_t mtypeFieldsLength = 4;
     static const int32_t idLenFieldsLength = 4;
+    static const int32_t headerLength = lenFieldsLength + mtypeFieldsLength + idLenFieldsLength;
+    static const int32_t kTypeMask = 0x0000FFFF; ///< mtype 字段中消息类型所占的位
+    static const int32_t kStreamFlag = 0x00010000; ///< 流式分片帧
+    static const int32_t kStreamEndFlag = 0x00020000; ///< 流式消息的最后一个分片
+    static const int32_t kCompressFlag = 0x00040000; ///< 正文经过zlib压缩
+    static const int32_t kChecksumFlag = 0x00080000; ///< 帧末尾带有CRC32C校验值
+    static const int32_t kKnownFlags = kStreamFlag | kStreamEndFlag | kCompressFlag | kChecksumFlag; ///< 可以解析的标志位
+    static const int32_t checksumLength = 4;
+    static constexpr size_t kMaxFieldLength = INT32_MAX; ///< 长度字段为有符号32位整数
+    static const uint32_t kSupportedCapabilities = CAP_STREAMING | CAP_CHECKSUM | CAP_COMPRESSION; ///< 当前实现支持的能力位
+    static const uint32_t kLegacyCapabilities = CAP_STREAMING; ///< 握手出现之前就已支持的能力位，对端不握手时按此发送
+    FrameOptions _options;
+    StreamContext _stream;
+    std::atomic<uint16_t> _version; ///< 协商后的协议版本
+    std::atomic<uint32_t> _capabilities; ///< 发送时启用的能力位
+    size_t _checksum_errors = 0; ///< 校验失败被丢弃的帧数，只在解析线程中修改
 };
 class ProtocolFactory{
 public:
@@ -121,29 +461,515 @@ public:
     static BaseProtocol::Ptr Create(Args&& ...args){
         return std::make_shared<LVProtocol>(std::forward<Args>(args)...); /// 这里的..., 是展开参数包的意思
     }
+    // ProtocolT 为抽象的 BaseProtocol 时由 Create 决定具体实现，否则直接构造该具体协议
+    template<typename ProtocolT>
+    static std::shared_ptr<ProtocolT> CreateAs(const FrameOptions& options){
+        if constexpr (std::is_abstract_v<ProtocolT>){
+            return Create(options);
+        }
+        else{
+            return std::make_shared<ProtocolT>(options);
+        }
+    }
+};
+
+/**
+ * @brief 从muduo缓冲区中循环解析出完整消息并交给handler处理
+ * @details 缓冲区包装对象构造在栈上，读事件不再产生堆分配；
+ *          ProtocolT 为具体协议类型时整个解析过程在编译期确定、可被内联，为 BaseProtocol 时经由虚函数分派
+ * @return false 表示数据错误或超过帧长度上限，调用方应关闭连接
+ */
+template<typename ProtocolT, typename BufferT, typename Handler>
+bool ProcessFrames(ProtocolT& protocol, muduo::net::Buffer* buffer, size_t max_frame_size, Handler&& handler){
+    BufferT base_buffer(buffer);
+    while(1){
+        if(protocol.CanProcessed(base_buffer) == false){
+            // 数据不足
+            if(base_buffer.ReadableSize() > max_frame_size){
+                LOG_ERROR("缓冲区数据过大");
+                return false;
+            }
+            LOG_DEBUG("数据不足");
+            break;
+        }
+        LOG_DEBUG("缓冲区中数据可处理");
+        BaseMessage::Ptr msg;
+        if(protocol.OnMessage(base_buffer, msg) == false){
+            LOG_ERROR("缓冲区数据错误");
+            return false;
+        }
+        if(msg.get() == nullptr){
+            continue; // 流式分片，完整消息尚未收齐
+        }
+        handler(msg);
+    }
+    return true;
+}
+
+/**
+ * @brief 在网络层应答心跳，心跳不交给上层回调
+ * @return true 表示消息是心跳请求且已应答
+ */
+inline bool AnswerHeartbeat(BaseConnection& conn, BaseMessage::Ptr& msg){
+    if(msg->GetMessType() != MessType::REQUEST_HEARTBEAT){
+        return false;
+    }
+    msg->SetMessType(MessType::RESPONSE_HEARTBEAT); // 原样带回发送时间
+    conn.Send(msg);
+    return true;
+}
+
+/**
+ * @brief 在网络层应答握手：按双方能力位的交集确定本连接发送时启用的帧特性，并把协商结果发回
+ * @return true 表示消息是握手请求且已处理
+ */
+inline bool AnswerHandshake(BaseConnection& conn, BaseMessage::Ptr& msg){
+    if(msg->GetMessType() != MessType::REQUEST_HANDSHAKE){
+        return false;
+    }
+    auto hello = std::dynamic_pointer_cast<HandshakeMessage>(msg);
+    auto protocol = conn.GetProtocol();
+    if(hello.get() == nullptr || protocol.get() == nullptr){
+        return true;
+    }
+    protocol->Negotiate(hello->Version(), hello->Capabilities());
+    LOG_INFO("握手完成, 协议版本 {}, 能力位 {:#x}", protocol->Version(), protocol->Capabilities());
+    hello->SetMessType(MessType::RESPONSE_HANDSHAKE);
+    hello->SetVersion(protocol->Version());
+    hello->SetCapabilities(protocol->Capabilities());
+    conn.Send(msg);
+    return true;
+}
+
+/**
+ * @brief 广播时按连接协商的能力位缓存已编码的帧
+ * @details 能力位相同的连接编码结果相同，共享同一份不可变的帧数据；组合通常只有一两种，消息一般只编码一次
+ */
+class FrameCache{
+public:
+    FrameCache(const BaseMessage::Ptr& msg):_msg(msg){}
+    // 编码失败返回空
+    EncodedFrame::Ptr Get(const BaseConnection::Ptr& conn){
+        auto protocol = conn->GetProtocol();
+        uint32_t key = protocol ? protocol->Capabilities() : 0;
+        for(auto& item : _frames){
+            if(item.first == key) return item.second;
+        }
+        auto frame = conn->Encode(_msg);
+        if(frame.get() != nullptr){
+            _frames.emplace_back(key, frame);
+        }
+        return frame;
+    }
+private:
+    BaseMessage::Ptr _msg;
+    std::vector<std::pair<uint32_t, EncodedFrame::Ptr>> _frames; ///< <能力位, 帧>，组合很少，线性查找
+};
+
+/**
+ * @brief 持有主循环与连接表的服务器公共部分，统一实现 Stop 与 QueuedBytes
+ * @details 派生类在连接建立时调用 AddConnection 登记、断开时调用 RemoveConnection 移除，并实现 StopAccepting。
+ *          Stop 先停止接受新连接，自动重连的客户端不会在等待期间重新连上；
+ *          之后登记的连接被拒绝，再关闭已有连接的写端并等待连接表清空，最多 flush_timeout_ms 后退出主循环
+ */
+class ConnectionTableServer : public BaseServer{
+public:
+    ConnectionTableServer()
+    :_stopping(false)
+    {}
+    virtual void Stop(int flush_timeout_ms = 0) override{
+        std::vector<BaseConnection::Ptr> conns;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _stopping = true;
+            for(auto& item : _conns){
+                conns.push_back(item.second);
+            }
+        }
+        _baseloop.runInLoop(std::bind(&ConnectionTableServer::StopAccepting, this));
+        for(auto& conn : conns){
+            conn->Shutdown();
+        }
+        __WaitConnectionsClosed(flush_timeout_ms);
+        _baseloop.quit();
+    }
+    virtual size_t QueuedBytes() override{
+        size_t total = 0;
+        std::unique_lock<std::mutex> lock(_mutex);
+        for(auto& item : _conns){
+            total += item.second->QueuedBytes();
+        }
+        return total;
+    }
+protected:
+    // 在主循环中调用，关闭监听，之后不再accept新连接
+    virtual void StopAccepting() = 0;
+    /**
+     * @param owner 连接的所有者，TcpConnection 或连接对象本身，断开时用同一个所有者移除
+     * @return 服务器已开始停止时返回false，不登记，调用方直接关闭连接
+     */
+    bool AddConnection(const std::shared_ptr<void>& owner, const BaseConnection::Ptr& conn){
+        std::unique_lock<std::mutex> lock(_mutex);
+        if(_stopping) return false;
+        _conns.emplace(owner, conn);
+        return true;
+    }
+    void RemoveConnection(const std::shared_ptr<void>& owner){
+        std::unique_lock<std::mutex> lock(_mutex);
+        _conns.erase(owner);
+    }
+private:
+    // 等待连接表清空(对端已关闭连接)，最多等待 timeout_ms，返回超时时仍未关闭的连接数量
+    size_t __WaitConnectionsClosed(int timeout_ms){
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while(true){
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if(_conns.empty()) return 0;
+                if(std::chrono::steady_clock::now() >= deadline){
+                    LOG_ERROR("等待连接关闭超时, 仍有 {} 个连接未关闭", _conns.size());
+                    return _conns.size();
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+protected:
+    muduo::net::EventLoop _baseloop;
+    std::mutex _mutex; ///< 保护连接表，派生类的其他共享状态也可以用它保护
+    std::unordered_map<std::shared_ptr<void>, BaseConnection::Ptr> _conns; ///< <所有者, 连接>
+private:
+    bool _stopping; ///< 由 _mutex 保护
+};
+
+/**
+ * @brief 空闲连接时间轮
+ * @details 做法与muduo的idleconnection示例相同：每个IO循环一个时间轮，runEvery每秒推进一格。
+ *          连接收到数据时把它的条目放进当前格子，条目只被格子持有，连接对象只保存弱引用；
+ *          持有条目的最后一个格子被淘汰，说明连续 idle_timeout_s 秒没有收到数据，条目析构时强制关闭连接。
+ *          同一秒内同一连接只放入一次，每条消息的代价是两次弱引用提升与一次比较。
+ *          时间轮由服务器持有，连接只保存弱引用，服务器析构时在事件循环仍然存在期间取消定时器
+ */
+class TimingWheel : public std::enable_shared_from_this<TimingWheel>{
+public:
+    using Ptr = std::shared_ptr<TimingWheel>;
+    struct Entry{
+        using Ptr = std::shared_ptr<Entry>;
+        explicit Entry(const muduo::net::TcpConnectionPtr& conn):conn(conn), tick(UINT64_MAX){}
+        ~Entry(){
+            auto connect = conn.lock();
+            if(connect && connect->connected()){
+                LOG_INFO("连接空闲超时, 关闭连接 {}", connect->name());
+                // 半开连接不会回应FIN，只关闭写端无法回收，这里直接关闭
+                connect->forceClose();
+            }
+        }
+        std::weak_ptr<muduo::net::TcpConnection> conn;
+        uint64_t tick; ///< 最近一次放入时的轮次
+    };
+    // 在loop所在线程中创建
+    static Ptr Create(muduo::net::EventLoop* loop, int idle_seconds){
+        Ptr wheel(new TimingWheel(loop, idle_seconds));
+        std::weak_ptr<TimingWheel> weak = wheel;
+        // 时间轮可能在其他线程析构，定时器只持有弱引用
+        wheel->_timer = loop->runEvery(1.0, [weak](){
+            if(auto self = weak.lock()) self->__OnTick();
+        });
+        return wheel;
+    }
+    ~TimingWheel(){
+        Cancel();
+    }
+    // 停止推进，可以重复调用；必须在loop析构之前调用
+    void Cancel(){
+        if(_cancelled) return ;
+        _cancelled = true;
+        _loop->cancel(_timer);
+    }
+    // 以下函数只在loop所在线程中调用
+    std::weak_ptr<Entry> Add(const muduo::net::TcpConnectionPtr& conn){
+        auto entry = std::make_shared<Entry>(conn);
+        Touch(entry);
+        return entry;
+    }
+    void Touch(const Entry::Ptr& entry){
+        if(entry->tick == _tick) return ;
+        entry->tick = _tick;
+        _buckets[_tick % _buckets.size()].push_back(entry);
+    }
+private:
+    TimingWheel(muduo::net::EventLoop* loop, int idle_seconds)
+    :_loop(loop), _buckets(std::max(idle_seconds, 1)), _tick(0), _cancelled(false)
+    {}
+    void __OnTick(){
+        // 下一格存放的是 idle_seconds 秒之前放入的条目，清空它；仍然活跃的连接在更新的格子里还有引用
+        ++_tick;
+        std::vector<Entry::Ptr> expired;
+        expired.swap(_buckets[_tick % _buckets.size()]);
+    }
+private:
+    muduo::net::EventLoop* _loop;
+    muduo::net::TimerId _timer;
+    std::vector<std::vector<Entry::Ptr>> _buckets; ///< 每秒一个格子
+    uint64_t _tick; ///< 已推进的轮次
+    bool _cancelled; ///< 定时器已取消
 };
 
-class MuduoConnection : public BaseConnection{
+/**
+ * @brief muduo连接
+ * @details ProtocolT/BufferT 为 BaseProtocol/MuduoBuffer 时协议可插拔(MuduoConnection)，
+ *          为具体协议时编解码调用在编译期确定(LVMuduoConnection)
+ */
+template<typename ProtocolT, typename BufferT>
+class MuduoConnectionT : public BaseConnection, public std::enable_shared_from_this<MuduoConnectionT<ProtocolT, BufferT>>{
 public:
-using Ptr = std::shared_ptr<MuduoConnection>;
-    virtual ~MuduoConnection() = default;
-    MuduoConnection(const BaseProtocol::Ptr& protocol, const muduo::net::TcpConnectionPtr& conn)
-    :_protocol(protocol), _conn(conn) {}
+using Ptr = std::shared_ptr<MuduoConnectionT>;
+using ProtocolPtr = std::shared_ptr<ProtocolT>;
+    virtual ~MuduoConnectionT() = default;
+    // cork_writes 开启写合并：同一次读事件或同一轮事件循环中产生的帧先汇集到合并缓冲区，再一次性写出
+    MuduoConnectionT(const ProtocolPtr& protocol, const muduo::net::TcpConnectionPtr& conn, bool cork_writes = false)
+    :_protocol(protocol), _conn(conn), _cork_writes(cork_writes), _cork_depth(0), _flush_pending(false),
+    _paused(false), _dropping(false), _queued(0), _dropped(0) {}
     virtual void Send(const BaseMessage::Ptr& msg) override{
-        std::string body = _protocol->Serialize(msg);
-        LOG_DEBUG("序列化发送的消息: \n{}", body);
-        _conn->send(body);
+        // 消息只编码一次，直接写入独立的发送缓冲区
+        muduo::net::Buffer buf;
+        BufferT out(&buf);
+        if(_protocol->Serialize(msg, out) == false){
+            return ;
+        }
+        LOG_DEBUG("序列化发送的消息, 长度: {}", buf.readableBytes());
+        auto loop = _conn->getLoop();
+        if(loop->isInLoopThread()){
+            __WriteInLoop(buf);
+            return ;
+        }
+        // 非IO线程(例如业务线程池)发送：编码在当前线程完成，缓冲区移动进任务，写操作通过runInLoop交还连接所属的IO线程
+        auto self = this->shared_from_this();
+        loop->runInLoop([self, buf = std::move(buf)]() mutable{
+            self->__WriteInLoop(buf);
+        });
+    }
+    virtual EncodedFrame::Ptr Encode(const BaseMessage::Ptr& msg) override{
+        muduo::net::Buffer buf;
+        BufferT out(&buf);
+        if(_protocol->Serialize(msg, out) == false){
+            return EncodedFrame::Ptr();
+        }
+        return std::make_shared<const EncodedFrame>(buf.retrieveAllAsString());
+    }
+    virtual void Send(const EncodedFrame::Ptr& frame) override{
+        auto loop = _conn->getLoop();
+        if(loop->isInLoopThread()){
+            __WriteInLoop(frame);
+            return ;
+        }
+        // 跨线程发送时任务只持有帧的引用计数，不拷贝帧数据
+        auto self = this->shared_from_this();
+        loop->runInLoop([self, frame](){
+            self->__WriteInLoop(frame);
+        });
     }
     virtual void Shutdown() override{
-        _conn->shutdown();
+        if(_cork_writes == false){
+            _conn->shutdown();
+            return ;
+        }
+        // 先写出合并缓冲区中尚未交给TcpConnection的数据，再关闭写端
+        auto self = this->shared_from_this();
+        _conn->getLoop()->runInLoop([self](){
+            self->__Flush();
+            self->_conn->shutdown();
+        });
     }
     virtual bool IsConnected() override{
         return _conn->connected();
     }
+    virtual BaseProtocol::Ptr GetProtocol() override{
+        return _protocol;
+    }
+    // 非虚接口，返回具体类型的协议对象
+    ProtocolT& Protocol(){
+        return *_protocol;
+    }
+    // 在IO线程中调用时返回准确值，其他线程返回最近一次写操作或水位事件时记录的值
+    virtual size_t QueuedBytes() override{
+        if(_conn->getLoop()->isInLoopThread()){
+            return __PendingBytes();
+        }
+        return _queued.load(std::memory_order_relaxed);
+    }
+    // 由服务器在连接建立时调用，连接所属循环的时间轮开始跟踪该连接
+    void SetIdleWheel(const TimingWheel::Ptr& wheel){
+        _wheel = wheel;
+        _idle_entry = wheel->Add(_conn);
+    }
+    // 收到数据，在IO线程中调用；服务器已经析构时时间轮不再存在
+    void Touch(){
+        auto entry = _idle_entry.lock();
+        if(entry.get() == nullptr) return ;
+        if(auto wheel = _wheel.lock()) wheel->Touch(entry);
+    }
+    // DROP 策略下累计丢弃的帧数
+    size_t DroppedFrames(){
+        return _dropped.load(std::memory_order_relaxed);
+    }
+    /**
+     * @brief 开启发送缓冲区水位控制
+     * @details 需要在连接对象交给shared_ptr管理之后、在连接所属的IO线程中调用；
+     *          high_water_mark 为0时不做任何限制
+     */
+    void SetBackpressure(const BackpressureOptions& options){
+        _backpressure = options;
+        if(options.high_water_mark == 0) return ;
+        std::weak_ptr<MuduoConnectionT> weak = this->weak_from_this();
+        _conn->setHighWaterMarkCallback([weak](const muduo::net::TcpConnectionPtr&, size_t bytes){
+            if(auto self = weak.lock()) self->__OnHighWaterMark(bytes);
+        }, options.high_water_mark);
+    }
+    /**
+     * @brief 写合并：Cork之后在IO线程中发送的帧只追加到合并缓冲区，最外层Uncork时一次写出
+     * @details 只能在连接所属的IO线程中调用，未开启写合并时为空操作
+     */
+    void Cork(){
+        if(_cork_writes) ++_cork_depth;
+    }
+    void Uncork(){
+        if(_cork_writes == false || _cork_depth == 0) return ;
+        if(--_cork_depth == 0){
+            __Flush();
+        }
+    }
+private:
+    void __WriteInLoop(muduo::net::Buffer& buf){
+        if(__Admit() == false){
+            return ;
+        }
+        if(_cork_writes == false){
+            _conn->send(&buf);
+            __UpdateQueued();
+            return ;
+        }
+        if(_cork_buf.readableBytes() == 0){
+            _cork_buf.swap(buf); // 合并缓冲区为空时直接交换，避免拷贝
+        }
+        else{
+            _cork_buf.append(buf.peek(), buf.readableBytes());
+        }
+        __ScheduleFlush();
+    }
+    void __WriteInLoop(const EncodedFrame::Ptr& frame){
+        if(__Admit() == false){
+            return ;
+        }
+        if(_cork_writes == false){
+            _conn->send(frame->Data(), frame->Size());
+            __UpdateQueued();
+            return ;
+        }
+        _cork_buf.append(frame->Data(), frame->Size());
+        __ScheduleFlush();
+    }
+    // 处于Cork区间时由Uncork负责写出；否则(例如业务线程投递过来的响应)在本轮事件循环的回调都执行完后统一写出
+    void __ScheduleFlush(){
+        if(_cork_depth > 0 || _flush_pending) return ;
+        _flush_pending = true;
+        auto self = this->shared_from_this();
+        _conn->getLoop()->queueInLoop([self](){
+            self->_flush_pending = false;
+            self->__Flush();
+        });
+    }
+    void __Flush(){
+        if(_cork_buf.readableBytes() == 0) return ;
+        _conn->send(&_cork_buf);
+        __UpdateQueued();
+    }
+    size_t __PendingBytes(){
+        return _conn->outputBuffer()->readableBytes() + _cork_buf.readableBytes();
+    }
+    void __UpdateQueued(){
+        _queued.store(__PendingBytes(), std::memory_order_relaxed);
+    }
+    // DROP 策略：超过高水位后丢弃整帧，直到待发送数据降到低水位以下，帧边界不受影响
+    bool __Admit(){
+        if(_dropping == false) return true;
+        if(__PendingBytes() <= _backpressure.low_water_mark){
+            __Recover();
+            return true;
+        }
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    // muduo在发送缓冲区跨过高水位时通过queueInLoop回调，此时已在IO线程中
+    void __OnHighWaterMark(size_t bytes){
+        _queued.store(bytes, std::memory_order_relaxed);
+        switch(_backpressure.policy){
+        case BackpressurePolicy::DISCONNECT:
+            LOG_ERROR("连接发送缓冲区达到高水位 {} 字节, 断开连接", bytes);
+            _conn->forceClose();
+            return ;
+        case BackpressurePolicy::DROP:
+            LOG_INFO("连接发送缓冲区达到高水位 {} 字节, 开始丢弃新消息", bytes);
+            _dropping = true;
+            break;
+        case BackpressurePolicy::PAUSE_READ:
+        case BackpressurePolicy::DEFAULT:
+            if(_paused) return ;
+            LOG_INFO("连接发送缓冲区达到高水位 {} 字节, 暂停读取对端数据", bytes);
+            _paused = true;
+            _conn->stopRead();
+            break;
+        }
+        // 发送缓冲区完全写空时一定可以恢复；只在超过高水位期间注册写完成回调，平时发送不承担额外开销
+        std::weak_ptr<MuduoConnectionT> weak = this->weak_from_this();
+        _conn->setWriteCompleteCallback([weak](const muduo::net::TcpConnectionPtr&){
+            if(auto self = weak.lock()) self->__Recover();
+        });
+        if(_paused){
+            __CheckLowWaterMark();
+        }
+    }
+    // 暂停读取期间本端不会再产生新的写操作，因此定时检查是否已降到低水位
+    void __CheckLowWaterMark(){
+        if(_paused == false || _conn->connected() == false) return ;
+        if(__PendingBytes() <= _backpressure.low_water_mark){
+            __Recover();
+            return ;
+        }
+        std::weak_ptr<MuduoConnectionT> weak = this->weak_from_this();
+        _conn->getLoop()->runAfter(kLowWaterCheckInterval, [weak](){
+            if(auto self = weak.lock()) self->__CheckLowWaterMark();
+        });
+    }
+    void __Recover(){
+        __UpdateQueued();
+        if(_paused == false && _dropping == false) return ;
+        LOG_INFO("连接发送缓冲区降到 {} 字节, 恢复正常收发", _queued.load(std::memory_order_relaxed));
+        if(_paused){
+            _paused = false;
+            _conn->startRead();
+        }
+        _dropping = false;
+        _conn->setWriteCompleteCallback(muduo::net::WriteCompleteCallback());
+    }
 private:
-    BaseProtocol::Ptr _protocol;
+    static constexpr double kLowWaterCheckInterval = 0.01; ///< 暂停读取期间检查低水位的间隔(秒)
+    ProtocolPtr _protocol;
     muduo::net::TcpConnectionPtr _conn;
+    bool _cork_writes; ///< 是否开启写合并
+    int _cork_depth; ///< Cork嵌套层数，仅在IO线程中访问
+    bool _flush_pending; ///< 是否已经投递了写出任务，仅在IO线程中访问
+    muduo::net::Buffer _cork_buf; ///< 写合并缓冲区，仅在IO线程中访问
+    BackpressureOptions _backpressure; ///< 水位控制配置
+    bool _paused; ///< PAUSE_READ 策略下是否已暂停读取，仅在IO线程中访问
+    bool _dropping; ///< DROP 策略下是否正在丢弃新帧，仅在IO线程中访问
+    std::atomic<size_t> _queued; ///< 最近一次记录的待发送字节数，供其他线程读取
+    std::atomic<size_t> _dropped; ///< 累计丢弃的帧数
+    std::weak_ptr<TimingWheel> _wheel; ///< 所属循环的空闲时间轮，由服务器持有；连接可能比服务器活得久
+    std::weak_ptr<TimingWheel::Entry> _idle_entry; ///< 时间轮中的条目，只由时间轮持有
 };
+using MuduoConnection = MuduoConnectionT<BaseProtocol, MuduoBuffer>;
+using LVMuduoConnection = MuduoConnectionT<LVProtocol, MuduoBuffer>;
 class ConnectionFactory{
 public:
     template<typename ...Args>
@@ -152,199 +978,2139 @@ public:
     }
 };
 
-class MuduoServer : public BaseServer{
+/**
+ * @brief muduo服务器
+ * @details MuduoServer 经由 BaseProtocol 虚接口解析消息，协议可以通过 ProtocolFactory 替换；
+ *          LVMuduoServer 的协议与缓冲区类型在编译期确定，读事件中的解析调用都是直接调用
+ */
+template<typename ProtocolT, typename BufferT>
+class MuduoServerT : public ConnectionTableServer{
 public:
-    using Ptr = std::shared_ptr<MuduoServer>;
-    MuduoServer(int16_t port)
-    :_server(&_baseloop, muduo::net::InetAddress("0.0.0.0", port),
-        "MuduoServer", muduo::net::TcpServer::kNoReusePort),
-    _protocol(ProtocolFactory::Create())
-    {}
+    using Ptr = std::shared_ptr<MuduoServerT>;
+    using ConnectionT = MuduoConnectionT<ProtocolT, BufferT>;
+    MuduoServerT(int16_t port, const ServerOptions& options = ServerOptions())
+    :_options(options),
+    _server(&_baseloop, muduo::net::InetAddress("0.0.0.0", port), "MuduoServer", 
+        options.reuse_port_shards > 0 ? muduo::net::TcpServer::kReusePort : muduo::net::TcpServer::kNoReusePort)
+    {
+        // 多Reactor模式：主循环只负责accept，连接按轮询分配到EventLoopThreadPool中的子循环
+        // 此时连接回调与消息回调都在子循环线程中执行，_conns 的访问需要加锁保护
+        _server.setThreadNum(_options.io_threads);
+        // 记录IO循环，unix域套接字上accept的连接同样分配到这些循环；开启空闲检查时在每个循环的线程中创建时间轮
+        _server.setThreadInitCallback([this](muduo::net::EventLoop* loop){
+            std::unique_lock<std::mutex> lock(_mutex);
+            _ioloops.push_back(loop);
+            if(_options.idle_timeout_s > 0){
+                _wheels.emplace(loop, TimingWheel::Create(loop, _options.idle_timeout_s));
+            }
+        });
+    }
+    virtual ~MuduoServerT(){
+        // 事件循环随 _server 与 _baseloop 析构，先取消时间轮的定时器
+        std::unique_lock<std::mutex> lock(_mutex);
+        for(auto& wheel : _wheels){
+            wheel.second->Cancel();
+        }
+    }
     virtual void Start() override{
-        _server.setConnectionCallback(std::bind(&MuduoServer::OnConnection, this, std::placeholders::_1)); //参数绑定
-        _server.setMessageCallback(std::bind(&MuduoServer::OnMessage, this, 
+        _server.setConnectionCallback(std::bind(&MuduoServerT::OnConnection, this, std::placeholders::_1)); //参数绑定
+        _server.setMessageCallback(std::bind(&MuduoServerT::OnMessage, this, 
                                     std::placeholders::_1,
                                     std::placeholders::_2,
                                     std::placeholders::_3));
         _server.start();
+        if(_options.unix_path.empty() == false){
+            __ListenUnix();
+        }
         _baseloop.loop();
     }
+protected:
+    // TcpServer 没有提供关闭 Acceptor 的接口，之后accept到的TCP连接由 OnConnection 直接关闭；unix域套接字停止监听
+    virtual void StopAccepting() override{
+        if(_unix_listener) _unix_listener->StopListening();
+    }
 private:
+    // unix域套接字连接与TCP连接走同一套连接与消息回调
+    void __ListenUnix(){
+        _unix_listener.reset(new UnixListener(&_baseloop, _options.unix_path, "MuduoServer"));
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _unix_listener->SetIoLoops(_ioloops);
+        }
+        _unix_listener->SetConnectionCallback(std::bind(&MuduoServerT::OnConnection, this, std::placeholders::_1));
+        _unix_listener->SetMessageCallback(std::bind(&MuduoServerT::OnMessage, this, 
+                                           std::placeholders::_1,
+                                           std::placeholders::_2,
+                                           std::placeholders::_3));
+        if(_unix_listener->Listen() == false){
+            _unix_listener.reset();
+        }
+    }
     void OnConnection(const muduo::net::TcpConnectionPtr& connect)
     {
        if(connect->connected())
         {
             LOG_INFO("连接建立!");
-            auto muduo_conn = ConnectionFactory::Create(_protocol, connect);
+            // 每个连接独立的协议对象，用于保存该连接的流式分片拼接状态
+            auto muduo_conn = std::make_shared<ConnectionT>(ProtocolFactory::CreateAs<ProtocolT>(_options.frame), connect, _options.cork_writes);
+            muduo_conn->SetBackpressure(_options.backpressure);
+            if(AddConnection(connect, muduo_conn) == false){
+                connect->forceClose(); // 服务器正在停止，上下文为空，断开时不再回调上层
+                return ;
+            }
+            // 连接对象直接挂在muduo连接的上下文中，消息路径据此取连接而不再查表加锁
+            connect->setContext(muduo_conn);
             {
                 std::unique_lock<std::mutex> lock(_mutex);
-                _conns.emplace(connect, muduo_conn);
+                auto wheel = _wheels.find(connect->getLoop());
+                if(wheel != _wheels.end()) muduo_conn->SetIdleWheel(wheel->second);
             }
             if(_cb_connection) _cb_connection(muduo_conn);
         }
         else
         {
             LOG_INFO("连接断开!");
-            BaseConnection::Ptr muduo_conn;
-            {
-                std::unique_lock<std::mutex> lock(_mutex);
-                auto it = _conns.find(connect);
-                if(it == _conns.end()){
-                    return ;
-                }
-                muduo_conn = it->second;
-                _conns.erase(connect);
+            if(connect->getContext().empty()){
+                return ;
             }
+            BaseConnection::Ptr muduo_conn = boost::any_cast<typename ConnectionT::Ptr>(connect->getContext());
+            // 清空上下文，打破 TcpConnection 与 MuduoConnection 之间的循环引用
+            connect->setContext(boost::any());
+            RemoveConnection(connect);
             if(_cb_close) _cb_close(muduo_conn);
         }
     }
     void OnMessage(const muduo::net::TcpConnectionPtr& connect, muduo::net::Buffer* buffer, muduo::Timestamp time)
     {
-        auto base_buffer = BufferFactory::Create(buffer);
-       
-        while(1){
-            if(_protocol->CanProcessed(base_buffer) == false){
-                // 数据不足
-                if(base_buffer->ReadableSize() > maxDataSize){
-                    connect->shutdown();
-                    LOG_ERROR("缓冲区数据过大");
-                    return ;
-                }
-                LOG_DEBUG("数据不足");
-                break;
-            }
-            LOG_DEBUG("缓冲区中数据可处理");
-            BaseMessage::Ptr msg;
-            bool ret = _protocol->OnMessage(base_buffer, msg);
-            if(ret == false){
-                connect->shutdown();
-                LOG_ERROR("缓冲区数据错误");
-                return ;
-            }
-            // 获取连接
-             BaseConnection::Ptr base_conn;
-            {
-                std::unique_lock<std::mutex> lock(_mutex);
-                auto it = _conns.find(connect);
-                if(it == _conns.end()){
-                    connect->shutdown();
-                    return ;
-                }
-                base_conn = it->second;
-            }
-            LOG_DEBUG("消息回调函数执行");
-            if(_cb_message) _cb_message(base_conn, msg);
+        // 从muduo连接的上下文中获取连接，以及连接所使用的协议，整个过程不加锁
+        if(connect->getContext().empty()){
+            connect->shutdown();
+            return ;
+        }
+        auto muduo_conn = boost::any_cast<typename ConnectionT::Ptr>(connect->getContext());
+        BaseConnection::Ptr base_conn = muduo_conn;
+        muduo_conn->Touch();
+        // 写合并：本次读事件中所有回调产生的响应在函数返回时一次写出
+        muduo_conn->Cork();
+        bool ret = ProcessFrames<ProtocolT, BufferT>(muduo_conn->Protocol(), buffer, _options.frame.max_frame_size,
+            [this, &base_conn](BaseMessage::Ptr& msg){
+                LOG_DEBUG("消息回调函数执行");
+                if(AnswerHeartbeat(*base_conn, msg) || AnswerHandshake(*base_conn, msg)) return ;
+                if(_cb_message) _cb_message(base_conn, msg);
+            });
+        muduo_conn->Uncork();
+        if(ret == false){
+            connect->shutdown();
         }
     }
 private:
-    static const int maxDataSize = (1<<16);
-    BaseProtocol::Ptr _protocol;
-    muduo::net::EventLoop _baseloop;
+    ServerOptions _options;
     muduo::net::TcpServer _server;
-    std::mutex _mutex;
-    std::unordered_map<muduo::net::TcpConnectionPtr, BaseConnection::Ptr> _conns;
+    // 连接表(_conns，以 TcpConnection 为所有者)只用于枚举与关闭，消息路径通过 TcpConnection::getContext 获取连接
+    std::vector<muduo::net::EventLoop*> _ioloops; ///< TcpServer 的IO循环
+    std::unordered_map<muduo::net::EventLoop*, TimingWheel::Ptr> _wheels; ///< 每个IO循环的空闲时间轮
+    std::unique_ptr<UnixListener> _unix_listener; ///< 配置了 unix_path 时的unix域套接字监听
 };
-class ServerFactory{
+using MuduoServer = MuduoServerT<BaseProtocol, MuduoBuffer>;
+using LVMuduoServer = MuduoServerT<LVProtocol, MuduoBuffer>;
+/**
+ * @brief SO_REUSEPORT 分片服务器
+ * @details 启动K个相互独立的 EventLoop+TcpServer 分片，以SO_REUSEPORT绑定同一端口，由内核在分片间均衡accept；
+ *          每个分片是一个单Reactor的MuduoServer，运行在绑定到固定CPU核的线程上，拥有自己的连接表，
+ *          分片之间不共享网络层状态。上层的Dispatcher在启动后只读，各分片并发查找不需要加锁
+ */
+class ReusePortServer : public BaseServer{
 public:
-    template<typename ...Args>
-    static BaseServer::Ptr Create(Args&& ...args){
-        return std::make_shared<MuduoServer>(std::forward<Args>(args)...); 
+    using Ptr = std::shared_ptr<ReusePortServer>;
+    ReusePortServer(int16_t port, const ServerOptions& options)
+    :_port(port), _options(options)
+    {
+        _options.io_threads = 0; // 分片本身就是一个线程一个循环
     }
-};
-
-class MuduoClient : public BaseClient{
-public:
-    using Ptr = std::shared_ptr<MuduoClient>;
-    MuduoClient(const std::string& sip, uint16_t port)
-    :_protocol(ProtocolFactory::Create()),
-    _baseloop(_loopthread.startLoop()),
-    _downlatch(1), // 初始化计数器为1，为0时被唤醒
-    _client(_baseloop, muduo::net::InetAddress(sip, port), "MuduoClient")
-    {}
-    virtual void Connect() override{
-         _client.setConnectionCallback(std::bind(&MuduoClient::OnConnection, this, std::placeholders::_1)); //参数绑定
-        _client.setMessageCallback(std::bind(&MuduoClient::OnMessage, this, 
-                                    std::placeholders::_1,
-                                    std::placeholders::_2,
-                                    std::placeholders::_3));
-        // 连接服务器
-        _client.connect();
-        _downlatch.wait(); //等待
+    virtual void Start() override{
+        // 每个分片运行在自己创建的线程中，绑核不影响调用线程；与MuduoServer::Start一样阻塞调用者直到全部分片退出
+        for(int i = 0; i < _options.reuse_port_shards; ++i){
+            _threads.emplace_back(&ReusePortServer::__RunShard, this, i);
+        }
+        for(auto& thread : _threads){
+            thread.join();
+        }
     }
-    virtual void Shutdown() override{
-        return _client.disconnect();
+    // 各分片并行停止，总等待时间不超过 flush_timeout_ms
+    virtual void Stop(int flush_timeout_ms = 0) override{
+        std::vector<BaseServer*> shards;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            shards = _shards;
+        }
+        std::vector<std::thread> stoppers;
+        for(auto shard : shards){
+            stoppers.emplace_back([shard, flush_timeout_ms](){ shard->Stop(flush_timeout_ms); });
+        }
+        for(auto& thread : stoppers){
+            thread.join();
+        }
+    }
+    virtual size_t QueuedBytes() override{
+        size_t total = 0;
+        std::unique_lock<std::mutex> lock(_mutex);
+        for(auto shard : _shards){
+            total += shard->QueuedBytes();
+        }
+        return total;
+    }
+private:
+    void __RunShard(int index){
+        if(_options.pin_shards){
+            __PinToCore(index);
+        }
+        if(_options.devirtualize){
+            __RunShardAs<LVMuduoServer>(index);
+        }
+        else{
+            __RunShardAs<MuduoServer>(index);
+        }
+    }
+    template<typename ServerT>
+    void __RunShardAs(int index){
+        // EventLoop 必须在运行它的线程中构造，因此分片在自己的线程中创建
+        // unix域套接字路径不能被多个分片同时绑定，只由分片0监听
+        ServerOptions options = _options;
+        if(index != 0) options.unix_path.clear();
+        ServerT server(_port, options);
+        server.SetConnectionCallBack(_cb_connection);
+        server.SetCloseCallBack(_cb_close);
+        server.SetMessageCallBack(_cb_message);
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _shards.push_back(&server);
+        }
+        LOG_INFO("SO_REUSEPORT 分片 {} 启动", index);
+        server.Start();
+        std::unique_lock<std::mutex> lock(_mutex);
+        _shards.erase(std::find(_shards.begin(), _shards.end(), &server));
+    }
+    static void __PinToCore(int index){
+        int cores = std::thread::hardware_concurrency();
+        if(cores <= 0) return ;
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(index % cores, &cpuset);
+        int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+        if(ret != 0){
+            LOG_ERROR("分片 {} 绑定CPU核失败: {}", index, ret);
+        }
+    }
+private:
+    int16_t _port;
+    ServerOptions _options;
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::vector<BaseServer*> _shards; ///< 正在运行的分片，供 Stop 使用
+};
+
+/**
+ * @brief 进程内所有MuduoClient共享的事件循环线程池
+ * @details 客户端不再各自创建EventLoopThread，按轮询分配到固定数量的循环上，
+ *          线程数不随服务提供者数量增长。muduo::net::EventLoopThreadPool 要求在基础循环的线程中取下一个循环，
+ *          而客户端可能在任意线程中创建，因此这里直接管理一组EventLoopThread
+ */
+class ClientLoopPool{
+public:
+    static ClientLoopPool& Instance(){
+        static ClientLoopPool pool;
+        return pool;
+    }
+    // 设置线程数量，只在第一个客户端创建之前调用有效
+    void SetThreadNum(size_t thread_num){
+        std::unique_lock<std::mutex> lock(_mutex);
+        if(_loops.empty() == false){
+            LOG_ERROR("客户端事件循环线程池已启动, 忽略线程数设置 {}", thread_num);
+            return ;
+        }
+        _thread_num = std::max<size_t>(thread_num, 1);
+    }
+    muduo::net::EventLoop* GetNextLoop(){
+        std::unique_lock<std::mutex> lock(_mutex);
+        if(_loops.empty()){
+            for(size_t i = 0; i < _thread_num; ++i){
+                _threads.emplace_back(new muduo::net::EventLoopThread(muduo::net::EventLoopThread::ThreadInitCallback(),
+                                                                      "ClientLoop" + std::to_string(i)));
+                _loops.push_back(_threads.back()->startLoop());
+            }
+            LOG_INFO("客户端事件循环线程池启动, 线程数: {}", _thread_num);
+        }
+        return _loops[_next++ % _loops.size()];
+    }
+private:
+    ClientLoopPool()
+    :_thread_num(std::max<size_t>(std::thread::hardware_concurrency(), 1)), _next(0){}
+    ClientLoopPool(const ClientLoopPool&) = delete;
+    ClientLoopPool& operator=(const ClientLoopPool&) = delete;
+private:
+    std::mutex _mutex;
+    size_t _thread_num; ///< 线程数量，默认等于CPU核数
+    size_t _next; ///< 轮询位置
+    std::vector<std::unique_ptr<muduo::net::EventLoopThread>> _threads;
+    std::vector<muduo::net::EventLoop*> _loops;
+};
+
+/**
+ * @brief 客户端对上层提供的稳定连接对象
+ * @details 发起连接后立即可用：连接建立之前发送的消息按顺序排队，连接建立后在IO线程中依次写出；
+ *          连接失败、超时或断开后进入关闭状态，排队的消息被丢弃，对应的请求由上层的关闭回调结束
+ */
+class ClientConnection : public BaseConnection{
+public:
+    using Ptr = std::shared_ptr<ClientConnection>;
+    ClientConnection():_state(State::CONNECTING), _srtt_us(0){}
+    virtual ~ClientConnection() = default;
+    virtual void Send(const BaseMessage::Ptr& msg) override{
+        BaseConnection::Ptr target;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if(_state == State::CONNECTING){
+                _pending.push_back(PendingSend{msg, EncodedFrame::Ptr()});
+                return ;
+            }
+            target = _target;
+        }
+        if(target.get() == nullptr){
+            LOG_ERROR("连接已关闭, 消息被丢弃");
+            return ;
+        }
+        target->Send(msg);
+    }
+    virtual EncodedFrame::Ptr Encode(const BaseMessage::Ptr& msg) override{
+        auto target = __Target();
+        if(target.get() == nullptr){
+            return EncodedFrame::Ptr();
+        }
+        return target->Encode(msg);
+    }
+    virtual void Send(const EncodedFrame::Ptr& frame) override{
+        BaseConnection::Ptr target;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if(_state == State::CONNECTING){
+                _pending.push_back(PendingSend{BaseMessage::Ptr(), frame});
+                return ;
+            }
+            target = _target;
+        }
+        if(target.get() == nullptr){
+            LOG_ERROR("连接已关闭, 消息被丢弃");
+            return ;
+        }
+        target->Send(frame);
+    }
+    virtual void Shutdown() override{
+        auto target = __Target();
+        if(target) target->Shutdown();
+    }
+    virtual bool IsConnected() override{
+        auto target = __Target();
+        return target && target->IsConnected();
+    }
+    virtual bool IsClosed() override{
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _state == State::CLOSED;
+    }
+    virtual BaseProtocol::Ptr GetProtocol() override{
+        auto target = __Target();
+        if(target.get() == nullptr){
+            return BaseProtocol::Ptr();
+        }
+        return target->GetProtocol();
+    }
+    virtual size_t QueuedBytes() override{
+        auto target = __Target();
+        return target ? target->QueuedBytes() : 0;
+    }
+    virtual int64_t RttUs() override{
+        return _srtt_us.load(std::memory_order_relaxed);
+    }
+    // 收到心跳应答时在IO线程中调用：与TCP的SRTT相同，按1/8的权重平滑
+    void UpdateRtt(int64_t rtt_us){
+        int64_t srtt = _srtt_us.load(std::memory_order_relaxed);
+        srtt = srtt == 0 ? rtt_us : srtt + (rtt_us - srtt) / 8;
+        _srtt_us.store(std::max<int64_t>(srtt, 1), std::memory_order_relaxed);
+    }
+    // 连接建立，在IO线程中调用：排队的消息在锁内依次写出，保证先于之后发送的消息
+    void Attach(const BaseConnection::Ptr& conn){
+        std::unique_lock<std::mutex> lock(_mutex);
+        _target = conn;
+        _state = State::CONNECTED;
+        for(auto& pending : _pending){
+            if(pending.msg) conn->Send(pending.msg);
+            else conn->Send(pending.frame);
+        }
+        _pending.clear();
+    }
+    // 重新连接时回到建立中状态，之后发送的消息再次排队
+    void Reset(){
+        std::unique_lock<std::mutex> lock(_mutex);
+        if(_state == State::CLOSED){
+            _state = State::CONNECTING;
+        }
+    }
+    // 连接失败、超时或断开
+    void Close(){
+        std::unique_lock<std::mutex> lock(_mutex);
+        _state = State::CLOSED;
+        _target.reset();
+        if(_pending.empty() == false){
+            LOG_ERROR("连接未能建立, 丢弃 {} 条排队的消息", _pending.size());
+            _pending.clear();
+        }
+    }
+private:
+    BaseConnection::Ptr __Target(){
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _target;
+    }
+private:
+    enum class State{
+        CONNECTING,
+        CONNECTED,
+        CLOSED
+    };
+    struct PendingSend{
+        BaseMessage::Ptr msg;
+        EncodedFrame::Ptr frame;
+    };
+    std::mutex _mutex;
+    State _state;
+    BaseConnection::Ptr _target; ///< 已建立的底层连接
+    std::vector<PendingSend> _pending; ///< 连接建立之前排队的消息
+    std::atomic<int64_t> _srtt_us; ///< 平滑往返时延，只由IO线程写入
+};
+
+/**
+ * @brief muduo客户端，与 MuduoServerT 一样分为可插拔(MuduoClient)与编译期确定(LVMuduoClient)两种实例
+ */
+template<typename ProtocolT, typename BufferT>
+class MuduoClientT : public BaseClient{
+public:
+    using Ptr = std::shared_ptr<MuduoClientT>;
+    using ConnectionT = MuduoConnectionT<ProtocolT, BufferT>;
+    MuduoClientT(const std::string& sip, uint16_t port, const ClientOptions& options = ClientOptions())
+    :_options(options),
+    _protocol(ProtocolFactory::CreateAs<ProtocolT>(options.frame)),
+    _proxy(std::make_shared<ClientConnection>()),
+    _connect_started(false),
+    _connect_done(false),
+    _connect_future(_connect_promise.get_future().share()),
+    _shutdown(false),
+    _generation(0),
+    _backoff_ms(options.reconnect_min_ms),
+    _missed_heartbeats(0),
+    _server_ip(sip),
+    _server_port(port),
+    _baseloop(ClientLoopPool::Instance().GetNextLoop())
+    {}
+    virtual ~MuduoClientT(){
+        // 共享的事件循环比客户端活得久：先在IO线程中摘掉连接上指向本对象的回调，避免析构之后仍被回调
+        if(_baseloop->isInLoopThread()){
+            __Detach();
+            return ;
+        }
+        muduo::CountDownLatch latch(1);
+        _baseloop->runInLoop([this, &latch](){
+            __Detach();
+            latch.countDown();
+        });
+        latch.wait();
+    }
+    virtual void Connect() override{
+        if(ConnectAsync().get() == false){
+            LOG_ERROR("连接服务器失败");
+        }
+    }
+    virtual std::shared_future<bool> ConnectAsync(const ConnectDoneCallBack& cb = ConnectDoneCallBack()) override{
+        if(_connect_started){
+            return _connect_future;
+        }
+        _connect_started = true;
+        _connect_cb = cb;
+        // 连接器只在IO线程中创建与访问，连接服务器，不等待结果
+        _baseloop->runInLoop(std::bind(&MuduoClientT::__StartConnect, this));
+        return _connect_future;
+    }
+    virtual void Shutdown() override{
+        // 主动关闭不再重连
+        _shutdown = true;
+        _baseloop->runInLoop([this](){
+            _baseloop->cancel(_reconnect_timer);
+            if(_client) _client->Disconnect();
+        });
     }
     virtual bool Send(const BaseMessage::Ptr& msg)override{
-        if(IsConnected() == false){
+        if(_proxy->IsClosed()){
             LOG_ERROR("连接已断开");
             return false;
         }
         LOG_DEBUG("客户端发送消息");
-        _conn->Send(msg);
+        _proxy->Send(msg);
         return true;
     }
     virtual bool IsConnected() override{
-        return (_conn && _conn->IsConnected());
+        return _proxy->IsConnected();
     }
+    // 返回稳定的连接对象，连接建立之前即可用于发送
     virtual BaseConnection::Ptr GetConnection() override{
-        return _conn;
+        return _proxy;
     }
 private:
-    void OnConnection(const muduo::net::TcpConnectionPtr& connect)
+    void __Detach(){
+        _shutdown = true;
+        _baseloop->cancel(_timeout_timer);
+        _baseloop->cancel(_reconnect_timer);
+        _baseloop->cancel(_heartbeat_timer);
+        auto connect = _client ? _client->Connection() : muduo::net::TcpConnectionPtr();
+        if(connect){
+            connect->setConnectionCallback(muduo::net::defaultConnectionCallback);
+            connect->setMessageCallback(muduo::net::defaultMessageCallback);
+        }
+        _client.reset(); // ClientSocket 只在IO线程中访问与销毁
+        __CloseProxy();
+        if(_connect_done == false){
+            _connect_done = true;
+            _connect_promise.set_value(false);
+        }
+    }
+    // 客户端被销毁时连接上可能还有未完成的请求：与连接断开一样调用关闭回调，由上层以断开错误结束这些请求；
+    // 连接此前已经关闭时关闭回调已经调用过，不再重复
+    void __CloseProxy(){
+        bool was_open = _proxy->IsClosed() == false;
+        _proxy->Close();
+        if(was_open && _cb_close) _cb_close(_proxy);
+    }
+    // 以下函数都在IO线程中执行
+    /**
+     * @brief 发起一次连接
+     * @details 每次连接都使用新的ClientSocket：muduo的Connector在连接成功之后不能再次start，
+     *          回调中带上连接代数，上一代ClientSocket迟到的连接事件直接丢弃；
+     *          服务器地址为 "unix:/path" 时走unix域套接字，否则走TCP
+     */
+    void __StartConnect(){
+        if(_shutdown) return ;
+        size_t generation = ++_generation;
+        _client = ClientSocketFactory::Create(_baseloop, _server_ip, _server_port, "MuduoClient");
+        _client->SetConnectionCallback(std::bind(&MuduoClientT::OnConnection, this, std::placeholders::_1, generation)); //参数绑定
+        _client->SetMessageCallback(std::bind(&MuduoClientT::OnMessage, this, 
+                                    std::placeholders::_1,
+                                    std::placeholders::_2,
+                                    std::placeholders::_3));
+        _client->SetConnectFailedCallback(std::bind(&MuduoClientT::__OnConnectFailed, this, generation));
+        // 定时器先于连接设置，Connect 中同步报告失败时可以一并取消
+        if(_options.connect_timeout_ms > 0){
+            _timeout_timer = _baseloop->runAfter(_options.connect_timeout_ms / 1000.0, 
+                                                 std::bind(&MuduoClientT::__OnConnectTimeout, this, generation));
+        }
+        _client->Connect();
+    }
+    void __FinishConnect(bool ok){
+        if(_connect_done) return ;
+        _connect_done = true;
+        _connect_promise.set_value(ok);
+        if(_connect_cb) _connect_cb(ok);
+    }
+    void __OnConnectTimeout(size_t generation){
+        if(generation != _generation || _proxy->IsClosed() || _proxy->IsConnected()) return ;
+        LOG_ERROR("连接服务器超时({} ms)", _options.connect_timeout_ms);
+        _client->Stop(); // 停止connector的重试
+        __OnClosed();
+        __FinishConnect(false);
+    }
+    // 连接器遇到重试也无法成功的错误，不必等到超时
+    void __OnConnectFailed(size_t generation){
+        if(generation != _generation || _proxy->IsClosed() || _proxy->IsConnected()) return ;
+        _baseloop->cancel(_timeout_timer);
+        __OnClosed();
+        __FinishConnect(false);
+    }
+    // 连接失败或断开：结束排队与未完成的请求，按需安排重连
+    void __OnClosed(){
+        _baseloop->cancel(_heartbeat_timer);
+        _proxy->Close();
+        if(_cb_close) _cb_close(_proxy);
+        __ScheduleReconnect();
+    }
+    // 指数退避：每次失败后等待时间翻倍，直到 reconnect_max_ms，连接成功后复位
+    void __ScheduleReconnect(){
+        if(_options.auto_reconnect == false || _shutdown) return ;
+        int delay = _backoff_ms;
+        _backoff_ms = std::min(_backoff_ms * 2, _options.reconnect_max_ms);
+        LOG_INFO("{} ms 后重新连接服务器 {}:{}", delay, _server_ip, _server_port);
+        _reconnect_timer = _baseloop->runAfter(delay / 1000.0, [this](){
+            if(_shutdown) return ;
+            _proxy->Reset();
+            __StartConnect();
+        });
+    }
+    /**
+     * @brief 心跳：每 heartbeat_interval_ms 发送一次ping，应答用于计算往返时延；
+     *        连续 heartbeat_max_missed 次没有应答时强制断开，交给关闭回调与重连处理，不必等TCP超时
+     */
+    void __StartHeartbeat(size_t generation){
+        if(_options.heartbeat_interval_ms <= 0) return ;
+        _missed_heartbeats = 0;
+        _heartbeat_timer = _baseloop->runEvery(_options.heartbeat_interval_ms / 1000.0,
+                                               std::bind(&MuduoClientT::__OnHeartbeatTimer, this, generation));
+    }
+    void __OnHeartbeatTimer(size_t generation){
+        auto connect = _client ? _client->Connection() : muduo::net::TcpConnectionPtr();
+        if(generation != _generation || connect.get() == nullptr || connect->connected() == false) return ;
+        if(_missed_heartbeats >= _options.heartbeat_max_missed){
+            LOG_ERROR("连续 {} 次心跳没有应答, 断开与服务器 {}:{} 的连接", _missed_heartbeats, _server_ip, _server_port);
+            _baseloop->cancel(_heartbeat_timer);
+            connect->forceClose();
+            return ;
+        }
+        ++_missed_heartbeats;
+        auto ping = MessageFactory::Create<HeartbeatMessage>();
+        ping->SetMessType(MessType::REQUEST_HEARTBEAT);
+        ping->SetTimestamp(__NowUs());
+        _proxy->Send(ping);
+    }
+    void __OnHeartbeatResponse(BaseMessage::Ptr& msg){
+        auto pong = std::dynamic_pointer_cast<HeartbeatMessage>(msg);
+        if(pong.get() == nullptr) return ;
+        _missed_heartbeats = 0;
+        int64_t rtt = static_cast<int64_t>(__NowUs() - pong->Timestamp());
+        if(rtt >= 0){
+            _proxy->UpdateRtt(rtt);
+        }
+    }
+    void __OnHandshakeResponse(BaseMessage::Ptr& msg){
+        auto hello = std::dynamic_pointer_cast<HandshakeMessage>(msg);
+        if(hello.get() == nullptr || _protocol.get() == nullptr) return ;
+        _protocol->Negotiate(hello->Version(), hello->Capabilities());
+        LOG_INFO("与服务器 {}:{} 握手完成, 协议版本 {}, 能力位 {:#x}", _server_ip, _server_port,
+                 _protocol->Version(), _protocol->Capabilities());
+    }
+    static uint64_t __NowUs(){
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    void OnConnection(const muduo::net::TcpConnectionPtr& connect, size_t generation)
     {
+        if(generation != _generation){
+            if(connect->connected()) connect->shutdown(); // 上一代ClientSocket迟到的连接
+            return ;
+        }
        if(connect->connected())
         {
+            if(_proxy->IsClosed()){
+                connect->shutdown(); // 超时之后才建立的连接
+                return ;
+            }
             LOG_INFO("连接建立!");
-            _downlatch.countDown(); //计数--，为0时唤醒阻塞
-            _conn = ConnectionFactory::Create(_protocol, connect);
+            _baseloop->cancel(_timeout_timer);
+            _backoff_ms = _options.reconnect_min_ms;
+            // 新连接使用新的协议对象，丢弃上一个连接可能残留的分片拼接状态
+            _protocol = ProtocolFactory::CreateAs<ProtocolT>(_options.frame);
+            auto conn = std::make_shared<ConnectionT>(_protocol, connect);
+            if(_options.handshake){
+                // 握手帧排在连接建立前排队的消息之前；应答到达之前按旧版本的帧特性发送
+                auto hello = MessageFactory::Create<HandshakeMessage>();
+                hello->SetMessType(MessType::REQUEST_HANDSHAKE);
+                hello->SetVersion(PROTOCOL_VERSION);
+                hello->SetCapabilities(_protocol->OfferedCapabilities());
+                conn->Send(hello);
+            }
+            _proxy->Attach(conn);
+            __StartHeartbeat(generation);
+            __FinishConnect(true);
+            if(_cb_connection) _cb_connection(_proxy);
         }
         else
         {
             LOG_INFO("连接断开!");
-            _conn.reset();
+            __OnClosed();
         }
     }
     void OnMessage(const muduo::net::TcpConnectionPtr& connect, muduo::net::Buffer* buffer, muduo::Timestamp time)
     {
         LOG_DEBUG("服务器有数据到来, 开始处理!");
-        auto base_buffer = BufferFactory::Create(buffer);
-        while(1){
-            if(_protocol->CanProcessed(base_buffer) == false){
-                // 数据不足
-                if(base_buffer->ReadableSize() > maxDataSize){
-                    connect->shutdown();
-                    LOG_ERROR("缓冲区数据过大");
-                    return ;
+        bool ret = ProcessFrames<ProtocolT, BufferT>(*_protocol, buffer, _options.frame.max_frame_size,
+            [this](BaseMessage::Ptr& msg){
+                LOG_DEBUG("缓冲区中数据解析完毕，调用回调函数进行处理");
+                if(msg->GetMessType() == MessType::RESPONSE_HEARTBEAT){
+                    return __OnHeartbeatResponse(msg);
+                }
+                if(msg->GetMessType() == MessType::RESPONSE_HANDSHAKE){
+                    return __OnHandshakeResponse(msg);
+                }
+                if(AnswerHeartbeat(*_proxy, msg)) return ;
+                if(_cb_message) _cb_message(_proxy, msg);
+            });
+        if(ret == false){
+            connect->shutdown();
+        }
+    }
+protected:
+    ClientOptions _options;
+    std::shared_ptr<ProtocolT> _protocol;
+    ClientConnection::Ptr _proxy; ///< 对上层暴露的连接对象，生命周期与客户端相同
+    bool _connect_started; ///< 是否已发起连接，仅在调用方线程中访问
+    bool _connect_done; ///< 连接结果是否已确定，仅在IO线程中访问
+    std::promise<bool> _connect_promise;
+    std::shared_future<bool> _connect_future;
+    ConnectDoneCallBack _connect_cb;
+    std::atomic<bool> _shutdown; ///< 已主动关闭，不再重连
+    size_t _generation; ///< 连接代数，仅在IO线程中访问
+    int _backoff_ms; ///< 下一次重连前的等待时间，仅在IO线程中访问
+    muduo::net::TimerId _timeout_timer; ///< 连接超时定时器
+    muduo::net::TimerId _reconnect_timer; ///< 重连定时器
+    muduo::net::TimerId _heartbeat_timer; ///< 心跳定时器
+    int _missed_heartbeats; ///< 连续没有应答的心跳次数，仅在IO线程中访问
+    std::string _server_ip; ///< 服务器IP，或 "unix:/path" 形式的unix域套接字地址
+    uint16_t _server_port;
+    muduo::net::EventLoop* _baseloop; ///< 从 ClientLoopPool 分配的共享事件循环
+    std::unique_ptr<ClientSocket> _client; ///< 当前这一代的连接器，仅在IO线程中访问
+};
+using MuduoClient = MuduoClientT<BaseProtocol, MuduoBuffer>;
+using LVMuduoClient = MuduoClientT<LVProtocol, MuduoBuffer>;
+
+/**
+ * @brief 共享内存连接
+ * @details 发送端把编码好的帧字节写入发送环，对端正在等待时写对端的eventfd唤醒；接收端在本端eventfd可读时取空接收环，
+ *          与TCP连接一样经 ProcessFrames 解析。环满时剩余字节暂存在本地缓冲区，对端读取后通过eventfd通知继续写入。
+ *          所有环操作都在连接所属的IO线程中进行，其他线程的发送编码后通过runInLoop转交
+ */
+template<typename ProtocolT, typename BufferT>
+class ShmConnectionT : public BaseConnection, public std::enable_shared_from_this<ShmConnectionT<ProtocolT, BufferT>>{
+public:
+    using Ptr = std::shared_ptr<ShmConnectionT>;
+    using ProtocolPtr = std::shared_ptr<ProtocolT>;
+    /**
+     * @param sockfd 握手所用的unix域套接字，连接期间保持打开，用于感知对端退出
+     * @param wake_fd 本端eventfd，peer_fd 对端eventfd；三个fd都由连接接管
+     */
+    ShmConnectionT(muduo::net::EventLoop* loop, const ProtocolPtr& protocol, ShmSegment::Ptr segment, bool is_server,
+                   int sockfd, int wake_fd, int peer_fd, const FrameOptions& frame, const ShmOptions& options)
+    :_loop(loop), _protocol(protocol), _segment(std::move(segment)),
+    _tx(_segment->TxRing(is_server)), _rx(_segment->RxRing(is_server)),
+    _sockfd(sockfd), _wake_fd(wake_fd), _peer_fd(peer_fd),
+    _wake_channel(loop, wake_fd), _sock_channel(loop, sockfd),
+    _frame(frame), _options(options), _connected(false), _shutdown_pending(false), _channels_removed(false), _drain_queued(false), _pending_out(0)
+    {}
+    virtual ~ShmConnectionT(){
+        ::close(_sockfd);
+        ::close(_wake_fd);
+        ::close(_peer_fd);
+    }
+    virtual void Send(const BaseMessage::Ptr& msg) override{
+        muduo::net::Buffer buf;
+        BufferT out(&buf);
+        if(_protocol->Serialize(msg, out) == false){
+            return ;
+        }
+        if(_loop->isInLoopThread()){
+            __WriteInLoop(buf.peek(), buf.readableBytes());
+            return ;
+        }
+        auto self = this->shared_from_this();
+        _loop->runInLoop([self, buf = std::move(buf)](){
+            self->__WriteInLoop(buf.peek(), buf.readableBytes());
+        });
+    }
+    virtual EncodedFrame::Ptr Encode(const BaseMessage::Ptr& msg) override{
+        muduo::net::Buffer buf;
+        BufferT out(&buf);
+        if(_protocol->Serialize(msg, out) == false){
+            return EncodedFrame::Ptr();
+        }
+        return std::make_shared<const EncodedFrame>(buf.retrieveAllAsString());
+    }
+    virtual void Send(const EncodedFrame::Ptr& frame) override{
+        if(_loop->isInLoopThread()){
+            __WriteInLoop(frame->Data(), frame->Size());
+            return ;
+        }
+        auto self = this->shared_from_this();
+        _loop->runInLoop([self, frame](){
+            self->__WriteInLoop(frame->Data(), frame->Size());
+        });
+    }
+    // 本地缓冲区中尚未写入环的数据写完之后再关闭，对端会先读完环中剩余的数据
+    virtual void Shutdown() override{
+        auto self = this->shared_from_this();
+        _loop->runInLoop([self](){
+            if(self->_pending_out.load(std::memory_order_relaxed) == 0){
+                self->__Close();
+                return ;
+            }
+            self->_shutdown_pending = true;
+        });
+    }
+    virtual bool IsConnected() override{
+        return _connected.load(std::memory_order_acquire);
+    }
+    virtual BaseProtocol::Ptr GetProtocol() override{
+        return _protocol;
+    }
+    // 发送环中对端尚未读取的字节加上本地缓冲区中的字节
+    virtual size_t QueuedBytes() override{
+        return _tx.Readable() + _pending_out.load(std::memory_order_relaxed);
+    }
+    // 以下三个函数只在IO线程中调用
+    void SetMessageHandler(const MessageCallBack& cb){ _on_message = cb; }
+    void SetCloseHandler(const CloseCallBack& cb){ _on_close = cb; }
+    // 开始收发：注册eventfd与套接字的读事件；注册之前对端已经写入的数据在本轮事件之后取走，
+    // 调用方在同一轮中完成的连接回调因此先于第一条消息执行
+    void Establish(){
+        auto self = this->shared_from_this();
+        _connected = true;
+        _wake_channel.tie(self);
+        _sock_channel.tie(self);
+        _wake_channel.setReadCallback(std::bind(&ShmConnectionT::__HandleWake, this));
+        _sock_channel.setReadCallback(std::bind(&ShmConnectionT::__HandlePeerClose, this));
+        _wake_channel.enableReading();
+        _sock_channel.enableReading();
+        __QueueDrain();
+    }
+    // 摘掉回调并立即关闭，所有者析构时使用；此时循环可能即将退出，通道直接移除而不等下一轮
+    void Detach(){
+        auto self = this->shared_from_this();
+        _loop->runInLoop([self](){
+            self->_on_message = MessageCallBack();
+            self->_on_close = CloseCallBack();
+            self->__Close();
+            self->__RemoveChannels();
+        });
+    }
+private:
+    void __WriteInLoop(const char* data, size_t len){
+        if(_connected == false || _shutdown_pending){
+            LOG_ERROR("共享内存连接已关闭, 消息被丢弃");
+            return ;
+        }
+        size_t n = 0;
+        if(_outbuf.readableBytes() == 0){
+            n = _tx.Write(data, len);
+            if(n > 0 && _tx.TakeReaderWaiting()) __Signal();
+        }
+        if(n < len){
+            _outbuf.append(data + n, len - n);
+            __FlushPending();
+        }
+    }
+    // 环满时在发送环上登记等待，对端读取之后会唤醒本端
+    void __FlushPending(){
+        while(_outbuf.readableBytes() > 0){
+            size_t n = _tx.Write(_outbuf.peek(), _outbuf.readableBytes());
+            if(n > 0){
+                _outbuf.retrieve(n);
+                if(_tx.TakeReaderWaiting()) __Signal();
+                continue;
+            }
+            if(_tx.PrepareWriterWait()) break;
+        }
+        _pending_out.store(_outbuf.readableBytes(), std::memory_order_relaxed);
+        if(_outbuf.readableBytes() == 0 && _shutdown_pending){
+            __Close();
+        }
+    }
+    void __HandleWake(){
+        if(_connected == false) return ;
+        uint64_t count = 0;
+        ssize_t n = ::read(_wake_fd, &count, sizeof(count)); // 只清零计数，本端可能同时在等数据与等空间
+        (void)n;
+        __FlushPending();
+        __Drain();
+    }
+    /**
+     * @brief 取空接收环并解析
+     * @details busy_poll_us 大于0时读空之后先自旋一段时间，对端在此期间写入不需要经过eventfd，
+     *          之后在接收环上登记等待，登记之后发现又有数据则继续读取。
+     *          一次最多读取 max_drain_bytes 字节，对端持续写入时不登记等待，把剩余的读取放到本轮事件之后，
+     *          同一循环上的其他连接在两次读取之间得到处理
+     */
+    void __Drain(){
+        _drain_queued = false;
+        auto self = this->shared_from_this();
+        BaseConnection::Ptr base = self;
+        auto deadline = std::chrono::steady_clock::time_point();
+        if(_options.busy_poll_us > 0){
+            deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(_options.busy_poll_us);
+        }
+        size_t drained = 0;
+        while(_connected){
+            size_t n = __ReadOnce(base);
+            if(n > 0){
+                drained += n;
+                if(_options.max_drain_bytes > 0 && drained >= _options.max_drain_bytes){
+                    __QueueDrain();
+                    break;
                 }
-                LOG_DEBUG("数据量不足");
-                break;
-            }
-            LOG_DEBUG("缓冲区消息可处理");
-            BaseMessage::Ptr msg;
-            bool ret = _protocol->OnMessage(base_buffer, msg);
-            if(ret == false){
-                connect->shutdown();
-                LOG_ERROR("缓冲区数据错误");
+                continue;
+            }
+            if(_options.busy_poll_us > 0 && std::chrono::steady_clock::now() < deadline){
+                continue;
+            }
+            if(_rx.PrepareReaderWait()) break;
+        }
+    }
+    void __QueueDrain(){
+        if(_drain_queued) return ;
+        _drain_queued = true;
+        auto self = this->shared_from_this();
+        _loop->queueInLoop([self](){
+            if(self->_drain_queued == false) return ; // 期间已被eventfd唤醒读取过
+            self->__Drain();
+        });
+    }
+    size_t __ReadOnce(const BaseConnection::Ptr& base){
+        size_t n = _rx.Read(&_inbuf);
+        if(n == 0) return 0;
+        if(_rx.TakeWriterWaiting()) __Signal();
+        bool ret = ProcessFrames<ProtocolT, BufferT>(*_protocol, &_inbuf, _frame.max_frame_size,
+            [this, &base](BaseMessage::Ptr& msg){
+                if(_on_message) _on_message(base, msg);
+            });
+        if(ret == false){
+            LOG_ERROR("共享内存连接数据错误, 关闭连接");
+            __Close();
+        }
+        return n;
+    }
+    // 对端关闭套接字或进程退出：先处理环中剩余的数据，再关闭
+    void __HandlePeerClose(){
+        if(_connected == false) return ;
+        char c;
+        ssize_t n = ::recv(_sockfd, &c, sizeof(c), MSG_DONTWAIT);
+        if(n > 0 || (n < 0 && (errno == EAGAIN || errno == EINTR))) return ;
+        BaseConnection::Ptr base = this->shared_from_this();
+        __ReadOnce(base);
+        __Close();
+    }
+    void __RemoveChannels(){
+        if(_channels_removed) return ;
+        _channels_removed = true;
+        _wake_channel.remove();
+        _sock_channel.remove();
+    }
+    void __Signal(){
+        uint64_t one = 1;
+        ssize_t n = ::write(_peer_fd, &one, sizeof(one));
+        (void)n;
+    }
+    void __Close(){
+        if(_connected == false) return ;
+        _connected = false;
+        auto self = this->shared_from_this();
+        // 同一轮事件中另一个通道可能也在活跃列表里，移除通道延后到本轮事件处理之后
+        _wake_channel.disableAll();
+        _sock_channel.disableAll();
+        _loop->queueInLoop([self](){
+            self->__RemoveChannels();
+        });
+        ::shutdown(_sockfd, SHUT_RDWR); // 对端读到EOF
+        _outbuf.retrieveAll();
+        _pending_out.store(0, std::memory_order_relaxed);
+        if(_on_close) _on_close(self);
+    }
+private:
+    muduo::net::EventLoop* _loop;
+    ProtocolPtr _protocol;
+    ShmSegment::Ptr _segment;
+    ShmRing _tx; ///< 发送环，本端是生产者
+    ShmRing _rx; ///< 接收环，本端是消费者
+    int _sockfd;
+    int _wake_fd;
+    int _peer_fd;
+    muduo::net::Channel _wake_channel;
+    muduo::net::Channel _sock_channel;
+    FrameOptions _frame;
+    ShmOptions _options;
+    std::atomic<bool> _connected;
+    bool _shutdown_pending; ///< 等本地缓冲区写完后关闭，仅在IO线程中访问
+    bool _channels_removed; ///< 通道是否已从循环中移除，仅在IO线程中访问
+    bool _drain_queued; ///< 接收环未读完、已排入循环等待继续读取，仅在IO线程中访问
+    muduo::net::Buffer _inbuf; ///< 从接收环取出、尚未拼成完整帧的数据
+    muduo::net::Buffer _outbuf; ///< 发送环已满时暂存的数据
+    std::atomic<size_t> _pending_out; ///< _outbuf 中的字节数，供其他线程读取
+    MessageCallBack _on_message;
+    CloseCallBack _on_close;
+};
+
+/**
+ * @brief 共享内存服务器
+ * @details 在unix域套接字上接受握手：客户端发来 memfd 与两端的eventfd，服务器映射共享内存后建立连接，
+ *          连接轮询分配到 io_threads 个IO循环上(为0时都在主循环上)。回调与 MuduoServer 相同，上层模块不感知传输方式。
+ *          水位控制、写合并与SO_REUSEPORT分片只适用于TCP，这里忽略对应配置
+ */
+template<typename ProtocolT, typename BufferT>
+class ShmServerT : public ConnectionTableServer{
+public:
+    using Ptr = std::shared_ptr<ShmServerT>;
+    using ConnectionT = ShmConnectionT<ProtocolT, BufferT>;
+    ShmServerT(const std::string& path, const ServerOptions& options = ServerOptions())
+    :_options(options), _listener(&_baseloop, ShmPath(path), "ShmServer"), _next_loop(0), _next_id(0)
+    {}
+    virtual ~ShmServerT(){
+        for(auto& item : _handshakes){
+            item.second.channel->disableAll();
+            item.second.channel->remove();
+            ::close(item.second.fd);
+        }
+        std::unique_lock<std::mutex> lock(_mutex);
+        for(auto& item : _conns){
+            std::static_pointer_cast<ConnectionT>(item.second)->Detach();
+        }
+    }
+    virtual void Start() override{
+        for(int i = 0; i < _options.io_threads; ++i){
+            _threads.emplace_back(new muduo::net::EventLoopThread(muduo::net::EventLoopThread::ThreadInitCallback(),
+                                                                  "ShmLoop" + std::to_string(i)));
+            _ioloops.push_back(_threads.back()->startLoop());
+        }
+        _listener.SetAcceptCallback(std::bind(&ShmServerT::__OnAccept, this, std::placeholders::_1));
+        if(_listener.Listen() == false){
+            LOG_ERROR("共享内存服务器启动失败");
+            return ;
+        }
+        _baseloop.loop();
+    }
+protected:
+    // 停止监听，尚未完成握手的套接字直接关闭
+    virtual void StopAccepting() override{
+        _listener.StopListening();
+        while(_handshakes.empty() == false){
+            ::close(__TakeHandshake(_handshakes.begin()));
+        }
+    }
+private:
+    static constexpr double kHandshakeTimeout = 3.0; ///< 等待客户端握手消息的时间(秒)
+    struct Handshake{
+        int fd;
+        std::shared_ptr<muduo::net::Channel> channel;
+    };
+    // 以下函数在主循环中执行
+    void __OnAccept(int fd){
+        uint64_t id = ++_next_id;
+        auto channel = std::make_shared<muduo::net::Channel>(&_baseloop, fd);
+        channel->setReadCallback(std::bind(&ShmServerT::__OnHello, this, id));
+        channel->enableReading();
+        _handshakes.emplace(id, Handshake{fd, channel});
+        _baseloop.runAfter(kHandshakeTimeout, [this, id](){
+            auto it = _handshakes.find(id);
+            if(it == _handshakes.end()) return ;
+            LOG_ERROR("共享内存客户端握手超时");
+            int fd = __TakeHandshake(it);
+            ::close(fd);
+        });
+    }
+    // 握手结束，返回套接字；通道在本轮事件处理之后销毁
+    int __TakeHandshake(typename std::unordered_map<uint64_t, Handshake>::iterator it){
+        int fd = it->second.fd;
+        auto channel = it->second.channel;
+        _handshakes.erase(it);
+        channel->disableAll();
+        channel->remove();
+        _baseloop.queueInLoop([channel](){});
+        return fd;
+    }
+    void __OnHello(uint64_t id){
+        auto it = _handshakes.find(id);
+        if(it == _handshakes.end()) return ;
+        ShmHello hello;
+        int fds[ShmHello::FD_COUNT];
+        int ret = detail::RecvHello(it->second.fd, hello, fds);
+        if(ret == 0) return ;
+        int sockfd = __TakeHandshake(it);
+        if(ret < 0){
+            ::close(sockfd);
+            return ;
+        }
+        // fds: memfd、客户端eventfd、服务端eventfd
+        auto segment = ShmSegment::Attach(fds[0], hello.ring_size);
+        if(segment.get() == nullptr){
+            ::close(fds[1]);
+            ::close(fds[2]);
+            ::close(sockfd);
+            return ;
+        }
+        muduo::net::EventLoop* ioloop = _ioloops.empty() ? &_baseloop : _ioloops[_next_loop++ % _ioloops.size()];
+        auto conn = std::make_shared<ConnectionT>(ioloop, ProtocolFactory::CreateAs<ProtocolT>(_options.frame), std::move(segment),
+                                                  true, sockfd, fds[2], fds[1], _options.frame, _options.shm);
+        conn->SetMessageHandler([this](const BaseConnection::Ptr& conn, BaseMessage::Ptr& msg){
+            if(AnswerHeartbeat(*conn, msg) || AnswerHandshake(*conn, msg)) return ;
+            if(_cb_message) _cb_message(conn, msg);
+        });
+        conn->SetCloseHandler([this](const BaseConnection::Ptr& conn){
+            LOG_INFO("共享内存连接断开!");
+            RemoveConnection(conn);
+            if(_cb_close) _cb_close(conn);
+        });
+        BaseConnection::Ptr base = conn; // 所有者与关闭回调收到的指针一致
+        if(AddConnection(base, base) == false){
+            return ; // 服务器正在停止，连接尚未注册到循环，析构时关闭全部fd
+        }
+        // 先开始收发再通知上层，连接回调中发出的消息不会因连接尚未建立而被丢弃
+        ioloop->runInLoop([this, conn](){
+            LOG_INFO("共享内存连接建立!");
+            conn->Establish();
+            if(_cb_connection) _cb_connection(conn);
+        });
+    }
+private:
+    ServerOptions _options;
+    UnixListener _listener;
+    std::vector<std::unique_ptr<muduo::net::EventLoopThread>> _threads;
+    std::vector<muduo::net::EventLoop*> _ioloops;
+    size_t _next_loop; ///< 轮询位置，仅在主循环中访问
+    uint64_t _next_id; ///< 握手编号，仅在主循环中访问
+    std::unordered_map<uint64_t, Handshake> _handshakes; ///< 已accept、尚未收到握手消息的套接字
+};
+using ShmServer = ShmServerT<BaseProtocol, MuduoBuffer>;
+using LVShmServer = ShmServerT<LVProtocol, MuduoBuffer>;
+
+/**
+ * @brief 共享内存客户端，地址形如 "shm:/path/to/socket"
+ * @details 客户端创建共享内存与两个eventfd，连接服务器的unix域套接字后一次性发出；
+ *          本地connect不会阻塞，服务器尚未监听时每隔100ms重试，直到 connect_timeout_ms。
+ *          GetConnection 返回的连接对象与 MuduoClient 一样在连接建立之前即可使用，不支持自动重连
+ */
+template<typename ProtocolT, typename BufferT>
+class ShmClientT : public BaseClient{
+public:
+    using Ptr = std::shared_ptr<ShmClientT>;
+    using ConnectionT = ShmConnectionT<ProtocolT, BufferT>;
+    ShmClientT(const std::string& address, const ClientOptions& options = ClientOptions())
+    :_options(options),
+    _path(ShmPath(address)),
+    _proxy(std::make_shared<ClientConnection>()),
+    _connect_started(false),
+    _connect_done(false),
+    _connect_future(_connect_promise.get_future().share()),
+    _shutdown(false),
+    _attempts(0),
+    _baseloop(ClientLoopPool::Instance().GetNextLoop())
+    {}
+    virtual ~ShmClientT(){
+        if(_baseloop->isInLoopThread()){
+            __Detach();
+            return ;
+        }
+        muduo::CountDownLatch latch(1);
+        _baseloop->runInLoop([this, &latch](){
+            __Detach();
+            latch.countDown();
+        });
+        latch.wait();
+    }
+    virtual void Connect() override{
+        if(ConnectAsync().get() == false){
+            LOG_ERROR("连接共享内存服务器失败");
+        }
+    }
+    virtual std::shared_future<bool> ConnectAsync(const ConnectDoneCallBack& cb = ConnectDoneCallBack()) override{
+        if(_connect_started){
+            return _connect_future;
+        }
+        _connect_started = true;
+        _connect_cb = cb;
+        _baseloop->runInLoop(std::bind(&ShmClientT::__TryConnect, this));
+        return _connect_future;
+    }
+    virtual void Shutdown() override{
+        _shutdown = true;
+        _baseloop->runInLoop([this](){
+            _baseloop->cancel(_retry_timer);
+            if(_conn) _conn->Shutdown();
+        });
+    }
+    virtual bool Send(const BaseMessage::Ptr& msg) override{
+        if(_proxy->IsClosed()){
+            LOG_ERROR("连接已断开");
+            return false;
+        }
+        _proxy->Send(msg);
+        return true;
+    }
+    virtual bool IsConnected() override{
+        return _proxy->IsConnected();
+    }
+    virtual BaseConnection::Ptr GetConnection() override{
+        return _proxy;
+    }
+private:
+    static constexpr int kRetryIntervalMs = 100;
+    // 以下函数都在IO线程中执行
+    void __TryConnect(){
+        if(_shutdown) return ;
+        sockaddr_un addr;
+        if(detail::FillUnixAddress(_path, addr) == false){
+            return __Fail();
+        }
+        int sockfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(sockfd < 0){
+            LOG_ERROR("创建unix域套接字失败: {}", std::strerror(errno));
+            return __Fail();
+        }
+        if(::connect(sockfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0){
+            int err = errno;
+            ::close(sockfd);
+            bool retry = err == EAGAIN || err == ENOENT || err == ECONNREFUSED || err == EINTR;
+            if(retry && ++_attempts * kRetryIntervalMs < std::max(_options.connect_timeout_ms, kRetryIntervalMs)){
+                _retry_timer = _baseloop->runAfter(kRetryIntervalMs / 1000.0, std::bind(&ShmClientT::__TryConnect, this));
                 return ;
             }
-            LOG_DEBUG("缓冲区中数据解析完毕，调用回调函数进行处理");
-            if(_cb_message) _cb_message(_conn, msg);
+            LOG_ERROR("连接共享内存服务器 {} 失败: {}", _path, std::strerror(err));
+            return __Fail();
+        }
+        auto segment = ShmSegment::Create(_options.shm.ring_size);
+        int client_efd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        int server_efd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        ShmHello hello;
+        bool ok = segment.get() != nullptr && client_efd >= 0 && server_efd >= 0;
+        if(ok){
+            hello.ring_size = segment->RingSize();
+            int fds[ShmHello::FD_COUNT] = {segment->Fd(), client_efd, server_efd};
+            ok = detail::SendHello(sockfd, hello, fds);
+        }
+        if(ok == false){
+            if(client_efd >= 0) ::close(client_efd);
+            if(server_efd >= 0) ::close(server_efd);
+            ::close(sockfd);
+            return __Fail();
+        }
+        _conn = std::make_shared<ConnectionT>(_baseloop, ProtocolFactory::CreateAs<ProtocolT>(_options.frame), std::move(segment),
+                                              false, sockfd, client_efd, server_efd, _options.frame, _options.shm);
+        _conn->SetMessageHandler([this](const BaseConnection::Ptr&, BaseMessage::Ptr& msg){
+            if(_cb_message) _cb_message(_proxy, msg);
+        });
+        _conn->SetCloseHandler([this](const BaseConnection::Ptr&){
+            LOG_INFO("共享内存连接断开!");
+            _conn.reset();
+            __OnClosed();
+        });
+        LOG_INFO("共享内存连接建立!");
+        _conn->Establish();
+        _proxy->Attach(_conn);
+        __FinishConnect(true);
+        if(_cb_connection) _cb_connection(_proxy);
+    }
+    void __Fail(){
+        __OnClosed();
+        __FinishConnect(false);
+    }
+    void __OnClosed(){
+        _proxy->Close();
+        if(_cb_close) _cb_close(_proxy);
+    }
+    void __FinishConnect(bool ok){
+        if(_connect_done) return ;
+        _connect_done = true;
+        _connect_promise.set_value(ok);
+        if(_connect_cb) _connect_cb(ok);
+    }
+    void __Detach(){
+        _shutdown = true;
+        _baseloop->cancel(_retry_timer);
+        if(_conn){
+            _conn->Detach();
+            _conn.reset();
+        }
+        // 与连接断开一样调用关闭回调，连接上未完成的请求以断开错误结束
+        bool was_open = _proxy->IsClosed() == false;
+        _proxy->Close();
+        if(was_open && _cb_close) _cb_close(_proxy);
+        if(_connect_done == false){
+            _connect_done = true;
+            _connect_promise.set_value(false);
+        }
+    }
+private:
+    ClientOptions _options;
+    std::string _path; ///< 服务器的unix域套接字路径
+    ClientConnection::Ptr _proxy; ///< 对上层暴露的连接对象
+    bool _connect_started; ///< 是否已发起连接，仅在调用方线程中访问
+    bool _connect_done; ///< 连接结果是否已确定，仅在IO线程中访问
+    std::promise<bool> _connect_promise;
+    std::shared_future<bool> _connect_future;
+    ConnectDoneCallBack _connect_cb;
+    std::atomic<bool> _shutdown;
+    int _attempts; ///< 已尝试连接的次数，仅在IO线程中访问
+    muduo::net::TimerId _retry_timer;
+    muduo::net::EventLoop* _baseloop; ///< 从 ClientLoopPool 分配的共享事件循环
+    typename ConnectionT::Ptr _conn; ///< 已建立的共享内存连接，仅在IO线程中访问
+};
+using ShmClient = ShmClientT<BaseProtocol, MuduoBuffer>;
+using LVShmClient = ShmClientT<LVProtocol, MuduoBuffer>;
+
+/**
+ * @brief io_uring 完成事件的接收者
+ * @details 提交请求时 user_data 为接收者地址与操作码的组合(地址按8字节对齐，低3位存放操作码)，完成时据此分派
+ */
+class UringHandler{
+public:
+    enum Op : uint8_t{
+        OP_ACCEPT = 1,
+        OP_RECV = 2,
+        OP_SEND = 3
+    };
+    virtual ~UringHandler() = default;
+    virtual void OnCompletion(uint8_t op, int32_t res, uint32_t flags) = 0;
+    // 本轮事件循环结束、提交请求之前调用，把本轮产生的发送数据合并成一个请求
+    virtual void OnFlush(){}
+};
+
+/**
+ * @brief 挂在muduo事件循环上的 io_uring 实例
+ * @details 完成事件到达时内核写eventfd，eventfd注册在事件循环上，读事件中取空完成队列并分派；
+ *          本轮事件中准备的所有请求在本轮结束时(queueInLoop)一次系统调用提交。
+ *          同一循环上的连接共享一组接收缓冲区。除 ForLoop 外所有函数只在loop所在线程中调用
+ */
+class UringLoop : public std::enable_shared_from_this<UringLoop>{
+public:
+    using Ptr = std::shared_ptr<UringLoop>;
+    static constexpr uint16_t kBufferGroup = 0;
+    // 在loop所在线程中调用，失败返回空
+    static Ptr Create(muduo::net::EventLoop* loop, const UringOptions& options){
+        auto queue = UringQueue::Create(options.entries);
+        if(queue.get() == nullptr){
+            return Ptr();
+        }
+        auto buffers = UringBufferRing::Create(*queue, kBufferGroup, options.buffers, options.buffer_size);
+        if(buffers.get() == nullptr){
+            return Ptr();
+        }
+        int efd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(efd < 0 || queue->RegisterEventfd(efd) == false){
+            if(efd >= 0) ::close(efd);
+            buffers->Unregister(*queue);
+            return Ptr();
+        }
+        Ptr uring(new UringLoop(loop, std::move(queue), std::move(buffers), efd));
+        uring->_channel.setReadCallback(std::bind(&UringLoop::__HandleCompletions, uring.get()));
+        uring->_channel.enableReading();
+        return uring;
+    }
+    // 客户端共享的事件循环各对应一个实例，第一次使用时在loop线程中创建，之后不再释放
+    static Ptr ForLoop(muduo::net::EventLoop* loop, const UringOptions& options){
+        static std::mutex mutex;
+        static auto* urings = new std::unordered_map<muduo::net::EventLoop*, Ptr>();
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = urings->find(loop);
+        if(it != urings->end()){
+            return it->second;
+        }
+        auto uring = Create(loop, options);
+        if(uring.get() != nullptr){
+            urings->emplace(loop, uring);
+        }
+        return uring;
+    }
+    ~UringLoop(){
+        _buffers->Unregister(*_queue);
+        ::close(_efd);
+    }
+    muduo::net::EventLoop* Loop(){ return _loop; }
+    UringBufferRing& Buffers(){ return *_buffers; }
+    // 多次触发的accept，一个请求持续接受新连接
+    bool Accept(UringHandler* handler, int fd){
+        io_uring_sqe* sqe = __GetSqe();
+        if(sqe == nullptr) return false;
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+        __SetData(sqe, handler, UringHandler::OP_ACCEPT);
+        return true;
+    }
+    // 多次触发的recv，数据写入内核从共享接收缓冲区中挑选的缓冲区
+    bool Recv(UringHandler* handler, int fd){
+        io_uring_sqe* sqe = __GetSqe();
+        if(sqe == nullptr) return false;
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = kBufferGroup;
+        __SetData(sqe, handler, UringHandler::OP_RECV);
+        return true;
+    }
+    // data 在完成之前必须保持有效
+    bool Send(UringHandler* handler, int fd, const char* data, size_t len){
+        io_uring_sqe* sqe = __GetSqe();
+        if(sqe == nullptr) return false;
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(data);
+        sqe->len = static_cast<uint32_t>(len);
+        sqe->msg_flags = MSG_NOSIGNAL;
+        __SetData(sqe, handler, UringHandler::OP_SEND);
+        return true;
+    }
+    // 本轮事件循环结束时调用 handler->OnFlush
+    void RequestFlush(const std::shared_ptr<UringHandler>& handler){
+        _flush_list.push_back(handler);
+        __ScheduleFlush();
+    }
+    // 登记处理者，请求未完成期间由这里保持其存活
+    void Retain(const std::shared_ptr<UringHandler>& handler){
+        _handlers.emplace(handler.get(), handler);
+    }
+    // 处理者不再有未完成的请求；可能在它自己的回调中调用，析构延后到本轮事件处理之后
+    void Release(UringHandler* handler){
+        auto it = _handlers.find(handler);
+        if(it == _handlers.end()) return ;
+        auto keep = std::move(it->second);
+        _handlers.erase(it);
+        _loop->queueInLoop([keep](){});
+    }
+    // 移除eventfd通道并释放所有处理者，在loop退出之前调用；之后到达的完成事件不再处理，未完成的请求随实例析构被内核取消
+    void Close(){
+        if(_closed) return ;
+        _closed = true;
+        _channel.disableAll();
+        _channel.remove();
+        _flush_list.clear();
+        _handlers.clear();
+    }
+private:
+    UringLoop(muduo::net::EventLoop* loop, UringQueue::Ptr queue, UringBufferRing::Ptr buffers, int efd)
+    :_loop(loop), _buffers(std::move(buffers)), _queue(std::move(queue)), _efd(efd), _channel(loop, efd),
+    _flush_queued(false), _closed(false)
+    {}
+    io_uring_sqe* __GetSqe(){
+        if(_closed) return nullptr;
+        io_uring_sqe* sqe = _queue->GetSqe();
+        if(sqe == nullptr){
+            _queue->Submit(); // 提交队列已满，先提交已准备的请求
+            sqe = _queue->GetSqe();
+            if(sqe == nullptr){
+                LOG_ERROR("io_uring提交队列已满");
+                return nullptr;
+            }
+        }
+        __ScheduleFlush();
+        return sqe;
+    }
+    static void __SetData(io_uring_sqe* sqe, UringHandler* handler, uint8_t op){
+        sqe->user_data = reinterpret_cast<uint64_t>(handler) | op;
+    }
+    void __ScheduleFlush(){
+        if(_flush_queued) return ;
+        _flush_queued = true;
+        std::weak_ptr<UringLoop> weak = shared_from_this();
+        _loop->queueInLoop([weak](){
+            if(auto self = weak.lock()) self->__Flush();
+        });
+    }
+    void __Flush(){
+        _flush_queued = false;
+        if(_closed) return ;
+        std::vector<std::shared_ptr<UringHandler>> flush;
+        flush.swap(_flush_list);
+        for(auto& handler : flush){
+            handler->OnFlush();
+        }
+        _queue->Submit();
+    }
+    void __HandleCompletions(){
+        uint64_t count = 0;
+        ssize_t n = ::read(_efd, &count, sizeof(count));
+        (void)n;
+        while(_closed == false){
+            _queue->ForEachCqe([](const io_uring_cqe& cqe){
+                auto handler = reinterpret_cast<UringHandler*>(cqe.user_data & ~uint64_t(7));
+                handler->OnCompletion(static_cast<uint8_t>(cqe.user_data & 7), cqe.res, cqe.flags);
+            });
+            if(_queue->CqOverflow() == false) break;
+            _queue->FlushOverflow();
+        }
+    }
+private:
+    muduo::net::EventLoop* _loop;
+    UringBufferRing::Ptr _buffers; ///< 先于 _queue 声明，io_uring 关闭之后才释放缓冲区
+    UringQueue::Ptr _queue;
+    int _efd;
+    muduo::net::Channel _channel;
+    bool _flush_queued; ///< 本轮是否已安排提交
+    bool _closed;
+    std::vector<std::shared_ptr<UringHandler>> _flush_list; ///< 本轮结束时需要合并发送的处理者
+    std::unordered_map<UringHandler*, std::shared_ptr<UringHandler>> _handlers;
+};
+
+/**
+ * @brief io_uring TCP连接
+ * @details 接收使用一个多次触发的recv请求，数据由内核写入共享接收缓冲区，复制进本地缓冲区后立即归还，
+ *          与muduo连接一样经 ProcessFrames 解析。发送时帧字节先追加到本地缓冲区，本轮事件循环结束时整块作为一个send请求提交；
+ *          上一个send完成之前追加的数据等它完成后再提交，每个连接同时最多一个send请求。
+ *          所有io_uring操作都在连接所属的IO线程中进行，其他线程的发送编码后通过runInLoop转交
+ */
+template<typename ProtocolT, typename BufferT>
+class UringConnectionT : public BaseConnection, public UringHandler,
+                         public std::enable_shared_from_this<UringConnectionT<ProtocolT, BufferT>>{
+public:
+    using Ptr = std::shared_ptr<UringConnectionT>;
+    using ProtocolPtr = std::shared_ptr<ProtocolT>;
+    // fd 为已连接的非阻塞套接字，由连接接管
+    UringConnectionT(const UringLoop::Ptr& uring, const ProtocolPtr& protocol, int fd, const FrameOptions& frame)
+    :_uring(uring), _loop(uring->Loop()), _protocol(protocol), _fd(fd), _frame(frame),
+    _connected(false), _shutdown_pending(false), _send_inflight(false), _flush_requested(false), _inflight(0), _queued(0)
+    {}
+    virtual ~UringConnectionT(){
+        ::close(_fd);
+    }
+    virtual void Send(const BaseMessage::Ptr& msg) override{
+        muduo::net::Buffer buf;
+        BufferT out(&buf);
+        if(_protocol->Serialize(msg, out) == false){
+            return ;
+        }
+        if(_loop->isInLoopThread()){
+            __WriteInLoop(buf.peek(), buf.readableBytes());
+            return ;
+        }
+        auto self = this->shared_from_this();
+        _loop->runInLoop([self, buf = std::move(buf)](){
+            self->__WriteInLoop(buf.peek(), buf.readableBytes());
+        });
+    }
+    virtual EncodedFrame::Ptr Encode(const BaseMessage::Ptr& msg) override{
+        muduo::net::Buffer buf;
+        BufferT out(&buf);
+        if(_protocol->Serialize(msg, out) == false){
+            return EncodedFrame::Ptr();
+        }
+        return std::make_shared<const EncodedFrame>(buf.retrieveAllAsString());
+    }
+    virtual void Send(const EncodedFrame::Ptr& frame) override{
+        if(_loop->isInLoopThread()){
+            __WriteInLoop(frame->Data(), frame->Size());
+            return ;
+        }
+        auto self = this->shared_from_this();
+        _loop->runInLoop([self, frame](){
+            self->__WriteInLoop(frame->Data(), frame->Size());
+        });
+    }
+    // 与muduo连接相同：已排队的数据写完之后关闭写端，对端关闭连接后本端随之关闭
+    virtual void Shutdown() override{
+        auto self = this->shared_from_this();
+        _loop->runInLoop([self](){
+            if(self->_connected == false) return ;
+            self->_shutdown_pending = true;
+            self->__MaybeShutdownWrite();
+        });
+    }
+    virtual bool IsConnected() override{
+        return _connected.load(std::memory_order_acquire);
+    }
+    virtual BaseProtocol::Ptr GetProtocol() override{
+        return _protocol;
+    }
+    // 尚未被内核接收的字节数
+    virtual size_t QueuedBytes() override{
+        return _queued.load(std::memory_order_relaxed);
+    }
+    // 以下函数只在IO线程中调用
+    void SetMessageHandler(const MessageCallBack& cb){ _on_message = cb; }
+    void SetCloseHandler(const CloseCallBack& cb){ _on_close = cb; }
+    // 开始收发：登记到io_uring实例并提交接收请求
+    void Establish(){
+        _connected = true;
+        _uring->Retain(this->shared_from_this());
+        __ArmRecv();
+    }
+    // 摘掉回调并立即关闭，所有者析构时使用
+    void Detach(){
+        auto self = this->shared_from_this();
+        _loop->runInLoop([self](){
+            self->_on_message = MessageCallBack();
+            self->_on_close = CloseCallBack();
+            self->__Close();
+        });
+    }
+    virtual void OnCompletion(uint8_t op, int32_t res, uint32_t flags) override{
+        if(op == OP_RECV){
+            __OnRecv(res, flags);
+        }
+        else if(op == OP_SEND){
+            __OnSend(res);
+        }
+        __MaybeRelease();
+    }
+    virtual void OnFlush() override{
+        _flush_requested = false;
+        if(_connected && _send_inflight == false && _outbuf.readableBytes() > 0){
+            __StartSend();
+        }
+    }
+private:
+    void __WriteInLoop(const char* data, size_t len){
+        if(_connected == false || _shutdown_pending){
+            LOG_ERROR("io_uring连接已关闭, 消息被丢弃");
+            return ;
+        }
+        _outbuf.append(data, len);
+        __UpdateQueued();
+        if(_send_inflight == false && _flush_requested == false){
+            _flush_requested = true;
+            _uring->RequestFlush(this->shared_from_this());
+        }
+    }
+    void __StartSend(){
+        _sending.swap(_outbuf);
+        __SubmitSend();
+    }
+    void __SubmitSend(){
+        if(_uring->Send(this, _fd, _sending.peek(), _sending.readableBytes()) == false){
+            __Close();
+            return ;
+        }
+        _send_inflight = true;
+        ++_inflight;
+    }
+    void __ArmRecv(){
+        if(_uring->Recv(this, _fd) == false){
+            __Close();
+            return ;
+        }
+        ++_inflight;
+    }
+    void __OnRecv(int32_t res, uint32_t flags){
+        bool more = flags & IORING_CQE_F_MORE;
+        if(more == false) --_inflight;
+        if(res > 0){
+            uint16_t bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+            _inbuf.append(_uring->Buffers().Buffer(bid), res);
+            _uring->Buffers().Recycle(bid);
+            if(_connected) __Process();
+        }
+        if(_connected == false || more) return ;
+        // 多次触发的请求已结束：缓冲区暂时用尽时重新提交，否则是对端关闭或出错
+        if(res > 0 || res == -ENOBUFS){
+            __ArmRecv();
+            return ;
+        }
+        if(res < 0){
+            LOG_ERROR("io_uring接收失败: {}", std::strerror(-res));
+        }
+        __Close();
+    }
+    void __Process(){
+        BaseConnection::Ptr base = this->shared_from_this();
+        bool ret = ProcessFrames<ProtocolT, BufferT>(*_protocol, &_inbuf, _frame.max_frame_size,
+            [this, &base](BaseMessage::Ptr& msg){
+                if(_on_message) _on_message(base, msg);
+            });
+        if(ret == false){
+            LOG_ERROR("io_uring连接数据错误, 关闭连接");
+            __Close();
         }
     }
+    void __OnSend(int32_t res){
+        --_inflight;
+        _send_inflight = false;
+        if(_connected == false) return ;
+        if(res < 0){
+            LOG_ERROR("io_uring发送失败: {}", std::strerror(-res));
+            __Close();
+            return ;
+        }
+        _sending.retrieve(res);
+        if(_sending.readableBytes() > 0){
+            __SubmitSend(); // 只发出了一部分
+        }
+        else if(_outbuf.readableBytes() > 0){
+            __StartSend(); // 发送期间追加的数据
+        }
+        else{
+            __MaybeShutdownWrite();
+        }
+        __UpdateQueued();
+    }
+    void __MaybeShutdownWrite(){
+        if(_shutdown_pending && _send_inflight == false && _outbuf.readableBytes() == 0 && _sending.readableBytes() == 0){
+            ::shutdown(_fd, SHUT_WR);
+        }
+    }
+    void __UpdateQueued(){
+        _queued.store(_outbuf.readableBytes() + _sending.readableBytes(), std::memory_order_relaxed);
+    }
+    // 关闭读写两端，未完成的recv随之以0结束，send以错误结束
+    void __Close(){
+        if(_connected == false) return ;
+        _connected = false;
+        ::shutdown(_fd, SHUT_RDWR);
+        _outbuf.retrieveAll();
+        _queued.store(0, std::memory_order_relaxed);
+        auto self = this->shared_from_this();
+        if(_on_close) _on_close(self);
+        __MaybeRelease();
+    }
+    // 已关闭且没有未完成的请求时，io_uring实例不再需要保持连接存活
+    void __MaybeRelease(){
+        if(_connected == false && _inflight == 0){
+            _uring->Release(this);
+        }
+    }
+private:
+    UringLoop::Ptr _uring;
+    muduo::net::EventLoop* _loop;
+    ProtocolPtr _protocol;
+    int _fd;
+    FrameOptions _frame;
+    std::atomic<bool> _connected;
+    bool _shutdown_pending; ///< 数据写完后关闭写端，以下成员仅在IO线程中访问
+    bool _send_inflight; ///< 是否有未完成的send请求
+    bool _flush_requested; ///< 是否已请求在本轮结束时提交发送
+    int _inflight; ///< 未完成的请求数量
+    muduo::net::Buffer _inbuf; ///< 已接收、尚未拼成完整帧的数据
+    muduo::net::Buffer _outbuf; ///< 等待提交的数据
+    muduo::net::Buffer _sending; ///< 正在发送的数据，请求完成之前不能改动
+    std::atomic<size_t> _queued; ///< _outbuf 与 _sending 中的字节数，供其他线程读取
+    MessageCallBack _on_message;
+    CloseCallBack _on_close;
+};
+
+/**
+ * @brief 基于io_uring的TCP服务器
+ * @details 主循环上一个多次触发的accept请求接受连接，连接轮询分配到 io_threads 个IO循环上(为0时都在主循环上)，
+ *          每个IO循环一个io_uring实例。帧格式与回调与 MuduoServer 相同，客户端可以是任意一种TCP客户端。
+ *          水位控制、写合并、空闲检查、SO_REUSEPORT分片与unix域套接字只适用于muduo服务器，这里忽略对应配置
+ */
+template<typename ProtocolT, typename BufferT>
+class UringServerT : public ConnectionTableServer, public UringHandler{
+public:
+    using Ptr = std::shared_ptr<UringServerT>;
+    using ConnectionT = UringConnectionT<ProtocolT, BufferT>;
+    UringServerT(int port, const ServerOptions& options = ServerOptions())
+    :_options(options), _port(port), _listenfd(-1), _accepting(true), _next_loop(0)
+    {}
+    virtual ~UringServerT(){
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            for(auto& item : _conns){
+                std::static_pointer_cast<ConnectionT>(item.second)->Detach();
+            }
+        }
+        // io_uring 实例的通道需要在各自的循环线程中移除，排在连接的 Detach 之后
+        for(size_t i = 0; i < _urings.size(); ++i){
+            muduo::CountDownLatch latch(1);
+            _ioloops[i]->runInLoop([this, i, &latch](){
+                _urings[i]->Close();
+                latch.countDown();
+            });
+            latch.wait();
+        }
+        // 主循环的实例同样在主循环线程中关闭；在创建服务器的线程中析构时 runInLoop 直接执行
+        if(_base_uring){
+            muduo::CountDownLatch latch(1);
+            _baseloop.runInLoop([this, &latch](){
+                _base_uring->Close();
+                latch.countDown();
+            });
+            latch.wait();
+        }
+        if(_listenfd >= 0) ::close(_listenfd);
+    }
+    virtual void Start() override{
+        if(__Listen() == false || __CreateUrings() == false){
+            LOG_ERROR("io_uring服务器启动失败");
+            return ;
+        }
+        if(_base_uring->Accept(this, _listenfd) == false){
+            LOG_ERROR("io_uring服务器启动失败");
+            return ;
+        }
+        _baseloop.loop();
+    }
+    // 主循环中的accept完成事件
+    virtual void OnCompletion(uint8_t op, int32_t res, uint32_t flags) override{
+        if(op != OP_ACCEPT) return ;
+        if(_accepting == false){
+            if(res >= 0) ::close(res);
+            return ;
+        }
+        if(res >= 0){
+            __NewConnection(res);
+        }
+        else{
+            LOG_ERROR("io_uring接受连接失败: {}", std::strerror(-res));
+        }
+        if(flags & IORING_CQE_F_MORE) return ;
+        // 多次触发的accept已结束；出错(如文件描述符耗尽)时稍后再提交，避免空转
+        if(res >= 0){
+            _base_uring->Accept(this, _listenfd);
+            return ;
+        }
+        _baseloop.runAfter(kAcceptRetryDelay, [this](){
+            if(_accepting) _base_uring->Accept(this, _listenfd);
+        });
+    }
 protected:
-    const int maxDataSize = (1<<16);
-    BaseProtocol::Ptr _protocol;
-    BaseConnection::Ptr _conn;
-    muduo::CountDownLatch _downlatch;
-    muduo::net::EventLoopThread _loopthread;
-    muduo::net::EventLoop* _baseloop;
-    muduo::net::TcpClient _client;
+    // 关闭监听套接字的读写，内核拒绝新连接，进行中的accept以错误结束且不再重新提交；fd在析构时关闭
+    virtual void StopAccepting() override{
+        _accepting = false;
+        if(_listenfd >= 0) ::shutdown(_listenfd, SHUT_RDWR);
+    }
+private:
+    static constexpr double kAcceptRetryDelay = 0.1; ///< accept出错后重新提交的等待时间(秒)
+    bool __Listen(){
+        _listenfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+        if(_listenfd < 0){
+            LOG_ERROR("创建套接字失败: {}", std::strerror(errno));
+            return false;
+        }
+        int one = 1;
+        ::setsockopt(_listenfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr;
+        ::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(static_cast<uint16_t>(_port));
+        if(::bind(_listenfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(_listenfd, SOMAXCONN) < 0){
+            LOG_ERROR("监听端口 {} 失败: {}", _port, std::strerror(errno));
+            return false;
+        }
+        return true;
+    }
+    // 每个循环一个io_uring实例，在各自的循环线程中创建
+    bool __CreateUrings(){
+        _base_uring = UringLoop::Create(&_baseloop, _options.uring);
+        if(_base_uring.get() == nullptr){
+            return false;
+        }
+        for(int i = 0; i < _options.io_threads; ++i){
+            _threads.emplace_back(new muduo::net::EventLoopThread(muduo::net::EventLoopThread::ThreadInitCallback(),
+                                                                  "UringLoop" + std::to_string(i)));
+            muduo::net::EventLoop* ioloop = _threads.back()->startLoop();
+            UringLoop::Ptr uring;
+            muduo::CountDownLatch latch(1);
+            ioloop->runInLoop([&](){
+                uring = UringLoop::Create(ioloop, _options.uring);
+                latch.countDown();
+            });
+            latch.wait();
+            if(uring.get() == nullptr){
+                return false;
+            }
+            _ioloops.push_back(ioloop);
+            _urings.push_back(uring);
+        }
+        return true;
+    }
+    void __NewConnection(int fd){
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        UringLoop::Ptr uring = _urings.empty() ? _base_uring : _urings[_next_loop++ % _urings.size()];
+        auto conn = std::make_shared<ConnectionT>(uring, ProtocolFactory::CreateAs<ProtocolT>(_options.frame), fd, _options.frame);
+        conn->SetMessageHandler([this](const BaseConnection::Ptr& conn, BaseMessage::Ptr& msg){
+            if(AnswerHeartbeat(*conn, msg) || AnswerHandshake(*conn, msg)) return ;
+            if(_cb_message) _cb_message(conn, msg);
+        });
+        conn->SetCloseHandler([this](const BaseConnection::Ptr& conn){
+            LOG_INFO("io_uring连接断开!");
+            RemoveConnection(conn);
+            if(_cb_close) _cb_close(conn);
+        });
+        BaseConnection::Ptr base = conn; // 所有者与关闭回调收到的指针一致
+        if(AddConnection(base, base) == false){
+            return ; // 服务器正在停止，连接析构时关闭fd
+        }
+        // 先开始收发再通知上层，连接回调中发出的消息不会因连接尚未建立而被丢弃
+        uring->Loop()->runInLoop([this, conn](){
+            LOG_INFO("io_uring连接建立!");
+            conn->Establish();
+            if(_cb_connection) _cb_connection(conn);
+        });
+    }
+private:
+    ServerOptions _options;
+    int _port;
+    int _listenfd;
+    bool _accepting; ///< 是否继续提交accept，仅在主循环中访问
+    UringLoop::Ptr _base_uring; ///< 主循环的io_uring实例，负责accept
+    std::vector<std::unique_ptr<muduo::net::EventLoopThread>> _threads;
+    std::vector<muduo::net::EventLoop*> _ioloops;
+    std::vector<UringLoop::Ptr> _urings; ///< 与 _ioloops 一一对应
+    size_t _next_loop; ///< 轮询位置，仅在主循环中访问
 };
+using UringServer = UringServerT<BaseProtocol, MuduoBuffer>;
+using LVUringServer = UringServerT<LVProtocol, MuduoBuffer>;
+
+/**
+ * @brief 基于io_uring的TCP客户端
+ * @details 非阻塞connect在共享事件循环上等待可写，连接建立后交给该循环的io_uring实例收发；
+ *          GetConnection 返回的连接对象与 MuduoClient 一样在连接建立之前即可使用，不支持自动重连与心跳；
+ *          ClientOptions::handshake 开启时与 MuduoClient 一样先发送握手帧，应答到达后按协商结果收发
+ */
+template<typename ProtocolT, typename BufferT>
+class UringClientT : public BaseClient{
+public:
+    using Ptr = std::shared_ptr<UringClientT>;
+    using ConnectionT = UringConnectionT<ProtocolT, BufferT>;
+    UringClientT(const std::string& sip, uint16_t port, const ClientOptions& options = ClientOptions())
+    :_options(options),
+    _server(sip, port),
+    _proxy(std::make_shared<ClientConnection>()),
+    _connect_started(false),
+    _connect_done(false),
+    _connect_future(_connect_promise.get_future().share()),
+    _shutdown(false),
+    _connfd(-1),
+    _baseloop(ClientLoopPool::Instance().GetNextLoop())
+    {}
+    virtual ~UringClientT(){
+        if(_baseloop->isInLoopThread()){
+            __Detach();
+            return ;
+        }
+        muduo::CountDownLatch latch(1);
+        _baseloop->runInLoop([this, &latch](){
+            __Detach();
+            latch.countDown();
+        });
+        latch.wait();
+    }
+    virtual void Connect() override{
+        if(ConnectAsync().get() == false){
+            LOG_ERROR("连接服务器失败");
+        }
+    }
+    virtual std::shared_future<bool> ConnectAsync(const ConnectDoneCallBack& cb = ConnectDoneCallBack()) override{
+        if(_connect_started){
+            return _connect_future;
+        }
+        _connect_started = true;
+        _connect_cb = cb;
+        _baseloop->runInLoop(std::bind(&UringClientT::__Connect, this));
+        return _connect_future;
+    }
+    virtual void Shutdown() override{
+        _shutdown = true;
+        _baseloop->runInLoop([this](){
+            if(_conn) _conn->Shutdown();
+        });
+    }
+    virtual bool Send(const BaseMessage::Ptr& msg) override{
+        if(_proxy->IsClosed()){
+            LOG_ERROR("连接已断开");
+            return false;
+        }
+        _proxy->Send(msg);
+        return true;
+    }
+    virtual bool IsConnected() override{
+        return _proxy->IsConnected();
+    }
+    virtual BaseConnection::Ptr GetConnection() override{
+        return _proxy;
+    }
+private:
+    // 以下函数都在IO线程中执行
+    void __Connect(){
+        if(_shutdown) return ;
+        int fd = ::socket(_server.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+        if(fd < 0){
+            LOG_ERROR("创建套接字失败: {}", std::strerror(errno));
+            return __Fail();
+        }
+        if(::connect(fd, _server.getSockAddr(), static_cast<socklen_t>(sizeof(sockaddr_in6))) == 0){
+            return __OnConnected(fd);
+        }
+        if(errno != EINPROGRESS){
+            LOG_ERROR("连接 {} 失败: {}", _server.toIpPort(), std::strerror(errno));
+            ::close(fd);
+            return __Fail();
+        }
+        _connfd = fd;
+        _connect_channel = std::make_shared<muduo::net::Channel>(_baseloop, fd);
+        _connect_channel->setWriteCallback(std::bind(&UringClientT::__OnWritable, this));
+        _connect_channel->enableWriting();
+        if(_options.connect_timeout_ms > 0){
+            _timeout_timer = _baseloop->runAfter(_options.connect_timeout_ms / 1000.0, [this](){
+                if(_connfd < 0) return ;
+                LOG_ERROR("连接 {} 超时", _server.toIpPort());
+                ::close(__TakeConnecting());
+                __Fail();
+            });
+        }
+    }
+    // 连接过程结束，返回套接字；通道在本轮事件处理之后销毁
+    int __TakeConnecting(){
+        int fd = _connfd;
+        _connfd = -1;
+        auto channel = std::move(_connect_channel);
+        channel->disableAll();
+        channel->remove();
+        _baseloop->queueInLoop([channel](){});
+        _baseloop->cancel(_timeout_timer);
+        return fd;
+    }
+    void __OnWritable(){
+        if(_connfd < 0) return ;
+        int fd = __TakeConnecting();
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if(::getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0){
+            err = errno;
+        }
+        if(err != 0){
+            LOG_ERROR("连接 {} 失败: {}", _server.toIpPort(), std::strerror(err));
+            ::close(fd);
+            return __Fail();
+        }
+        __OnConnected(fd);
+    }
+    void __OnConnected(int fd){
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        auto uring = UringLoop::ForLoop(_baseloop, _options.uring);
+        if(uring.get() == nullptr){
+            ::close(fd);
+            return __Fail();
+        }
+        auto protocol = ProtocolFactory::CreateAs<ProtocolT>(_options.frame);
+        _conn = std::make_shared<ConnectionT>(uring, protocol, fd, _options.frame);
+        _conn->SetMessageHandler([this, protocol](const BaseConnection::Ptr&, BaseMessage::Ptr& msg){
+            if(msg->GetMessType() == MessType::RESPONSE_HANDSHAKE){
+                return __OnHandshakeResponse(*protocol, msg);
+            }
+            if(_cb_message) _cb_message(_proxy, msg);
+        });
+        _conn->SetCloseHandler([this](const BaseConnection::Ptr&){
+            LOG_INFO("io_uring连接断开!");
+            _conn.reset();
+            __OnClosed();
+        });
+        LOG_INFO("io_uring连接建立!");
+        _conn->Establish();
+        if(_options.handshake){
+            // 握手帧排在连接建立前排队的消息之前；应答到达之前按旧版本的帧特性发送
+            auto hello = MessageFactory::Create<HandshakeMessage>();
+            hello->SetMessType(MessType::REQUEST_HANDSHAKE);
+            hello->SetVersion(PROTOCOL_VERSION);
+            hello->SetCapabilities(protocol->OfferedCapabilities());
+            _conn->Send(hello);
+        }
+        _proxy->Attach(_conn);
+        __FinishConnect(true);
+        if(_cb_connection) _cb_connection(_proxy);
+    }
+    void __OnHandshakeResponse(ProtocolT& protocol, BaseMessage::Ptr& msg){
+        auto hello = std::dynamic_pointer_cast<HandshakeMessage>(msg);
+        if(hello.get() == nullptr) return ;
+        protocol.Negotiate(hello->Version(), hello->Capabilities());
+        LOG_INFO("与服务器 {} 握手完成, 协议版本 {}, 能力位 {:#x}", _server.toIpPort(),
+                 protocol.Version(), protocol.Capabilities());
+    }
+    void __Fail(){
+        __OnClosed();
+        __FinishConnect(false);
+    }
+    void __OnClosed(){
+        _proxy->Close();
+        if(_cb_close) _cb_close(_proxy);
+    }
+    void __FinishConnect(bool ok){
+        if(_connect_done) return ;
+        _connect_done = true;
+        _connect_promise.set_value(ok);
+        if(_connect_cb) _connect_cb(ok);
+    }
+    void __Detach(){
+        _shutdown = true;
+        if(_connfd >= 0){
+            ::close(__TakeConnecting());
+        }
+        if(_conn){
+            _conn->Detach();
+            _conn.reset();
+        }
+        // 与连接断开一样调用关闭回调，连接上未完成的请求以断开错误结束
+        bool was_open = _proxy->IsClosed() == false;
+        _proxy->Close();
+        if(was_open && _cb_close) _cb_close(_proxy);
+        if(_connect_done == false){
+            _connect_done = true;
+            _connect_promise.set_value(false);
+        }
+    }
+private:
+    ClientOptions _options;
+    muduo::net::InetAddress _server;
+    ClientConnection::Ptr _proxy; ///< 对上层暴露的连接对象
+    bool _connect_started; ///< 是否已发起连接，仅在调用方线程中访问
+    bool _connect_done; ///< 连接结果是否已确定，仅在IO线程中访问
+    std::promise<bool> _connect_promise;
+    std::shared_future<bool> _connect_future;
+    ConnectDoneCallBack _connect_cb;
+    std::atomic<bool> _shutdown;
+    int _connfd; ///< 正在连接的套接字，仅在IO线程中访问
+    std::shared_ptr<muduo::net::Channel> _connect_channel; ///< 等待connect完成的通道
+    muduo::net::TimerId _timeout_timer;
+    muduo::net::EventLoop* _baseloop; ///< 从 ClientLoopPool 分配的共享事件循环
+    typename ConnectionT::Ptr _conn; ///< 已建立的连接，仅在IO线程中访问
+};
+using UringClient = UringClientT<BaseProtocol, MuduoBuffer>;
+using LVUringClient = UringClientT<LVProtocol, MuduoBuffer>;
+
+class ServerFactory{
+public:
+    // 根据配置选择服务器实现：shm_path 非空时使用共享内存服务器(忽略端口)，io_uring 为真时使用io_uring服务器，
+    // reuse_port_shards 大于0时使用SO_REUSEPORT分片模式
+    static BaseServer::Ptr Create(int16_t port, const ServerOptions& options = ServerOptions()){
+        if(options.unix_path.empty() == false && ListensOnUnixPath(options) == false){
+            LOG_ERROR("当前服务器类型不支持unix域套接字, 忽略 unix_path {}", options.unix_path);
+        }
+        if(options.shm_path.empty() == false){
+            if(options.devirtualize){
+                return std::make_shared<LVShmServer>(options.shm_path, options);
+            }
+            return std::make_shared<ShmServer>(options.shm_path, options);
+        }
+        if(options.io_uring){
+            if(options.devirtualize){
+                return std::make_shared<LVUringServer>(port, options);
+            }
+            return std::make_shared<UringServer>(port, options);
+        }
+        if(options.reuse_port_shards > 0){
+            return std::make_shared<ReusePortServer>(port, options);
+        }
+        if(options.devirtualize){
+            return std::make_shared<LVMuduoServer>(port, options);
+        }
+        return std::make_shared<MuduoServer>(port, options);
+    }
+    // 按该配置创建的服务器是否在 unix_path 上监听；共享内存服务器与io_uring服务器忽略该项，此时不能把它上报给注册中心
+    static bool ListensOnUnixPath(const ServerOptions& options){
+        return options.unix_path.empty() == false && options.shm_path.empty() && options.io_uring == false;
+    }
+};
+
 class ClientFactory{
 public:
-    template<typename ...Args>
-    static BaseClient::Ptr Create(Args&& ...args){
-        return std::make_shared<MuduoClient>(std::forward<Args>(args)...); 
+    // 根据配置选择客户端实现：devirtualize 为真时使用编译期确定协议类型的 LVMuduoClient
+    // sip 为 "unix:/path" 时连接unix域套接字，为 "shm:/path" 时使用共享内存传输，这两种情况下 port 被忽略；
+    // io_uring 为真时TCP地址使用io_uring客户端
+    static BaseClient::Ptr Create(const std::string& sip, uint16_t port, const ClientOptions& options = ClientOptions()){
+        if(IsShmAddress(sip)){
+            if(options.devirtualize){
+                return std::make_shared<LVShmClient>(sip, options);
+            }
+            return std::make_shared<ShmClient>(sip, options);
+        }
+        if(options.io_uring && IsUnixAddress(sip) == false){
+            if(options.devirtualize){
+                return std::make_shared<LVUringClient>(sip, port, options);
+            }
+            return std::make_shared<UringClient>(sip, port, options);
+        }
+        if(options.devirtualize){
+            return std::make_shared<LVMuduoClient>(sip, port, options);
+        }
+        return std::make_shared<MuduoClient>(sip, port, options);
     }
 };
 }
\ No newline at end of file
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <muduo/net/Buffer.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include "Logging.hpp"
+
+/*
+    共享内存传输的底层部件
+    一条连接对应一段memfd共享内存，其中是两个方向各一个的单生产者单消费者字节环，
+    每一端各有一个eventfd用于唤醒；memfd与eventfd通过unix域套接字以SCM_RIGHTS传给对端，
+    该套接字在连接期间保持打开，任意一端退出时对端读到EOF即认为连接断开
+*/
+namespace base{
+inline const std::string SHM_SCHEME = "shm:";
+
+inline bool IsShmAddress(const std::string& address){
+    return address.compare(0, SHM_SCHEME.size(), SHM_SCHEME) == 0;
+}
+inline std::string ShmPath(const std::string& address){
+    return IsShmAddress(address) ? address.substr(SHM_SCHEME.size()) : address;
+}
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "共享内存中的原子变量必须是无锁的");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "共享内存中的原子变量必须是无锁的");
+
+/**
+ * @brief 环的控制块，位于共享内存中环数据之前
+ * @details 读写位置单调递增、各占一个缓存行，避免生产者与消费者之间的伪共享；
+ *          等待标志与位置之间按Dekker方式使用seq_cst栅栏，保证不会漏掉唤醒
+ */
+struct ShmRingHeader{
+    alignas(64) std::atomic<uint64_t> head; ///< 读位置，只由消费者修改
+    alignas(64) std::atomic<uint64_t> tail; ///< 写位置，只由生产者修改
+    alignas(64) std::atomic<uint32_t> reader_waiting; ///< 消费者已读空，等待eventfd唤醒
+    std::atomic<uint32_t> writer_waiting; ///< 生产者因环满等待空间
+    uint64_t capacity; ///< 数据区大小，2的幂，仅供调试查看
+};
+
+/**
+ * @brief 共享内存中的单生产者单消费者字节环
+ * @details 环中传递的是连续的协议字节流，帧可以跨越多次写入，由读端的协议对象负责拼帧；
+ *          Write 只能由一个线程调用，Read 只能由另一个线程调用
+ */
+class ShmRing{
+public:
+    ShmRing():_hdr(nullptr), _data(nullptr), _capacity(0), _mask(0){}
+    // 容量取本端记录的值而不是控制块中的值，对端改写共享内存不会造成越界访问
+    ShmRing(void* base, size_t capacity)
+    :_hdr(static_cast<ShmRingHeader*>(base)),
+    _data(static_cast<char*>(base) + sizeof(ShmRingHeader)),
+    _capacity(capacity),
+    _mask(capacity - 1)
+    {}
+    static size_t RegionSize(size_t capacity){
+        return sizeof(ShmRingHeader) + capacity;
+    }
+    // 由创建共享内存的一端调用一次
+    static void Init(void* base, size_t capacity){
+        auto hdr = new (base) ShmRingHeader();
+        hdr->head.store(0, std::memory_order_relaxed);
+        hdr->tail.store(0, std::memory_order_relaxed);
+        hdr->reader_waiting.store(0, std::memory_order_relaxed);
+        hdr->writer_waiting.store(0, std::memory_order_relaxed);
+        hdr->capacity = capacity;
+    }
+    // 生产者：尽量写入，返回实际写入的字节数
+    size_t Write(const char* data, size_t len){
+        uint64_t tail = _hdr->tail.load(std::memory_order_relaxed);
+        uint64_t head = _hdr->head.load(std::memory_order_acquire);
+        if(tail - head >= _capacity) return 0;
+        size_t n = std::min<size_t>(len, _capacity - (tail - head));
+        size_t pos = tail & _mask;
+        size_t first = std::min<size_t>(n, _capacity - pos);
+        std::memcpy(_data + pos, data, first);
+        std::memcpy(_data, data + first, n - first);
+        _hdr->tail.store(tail + n, std::memory_order_release);
+        return n;
+    }
+    // 消费者：把环中所有可读数据追加到buf，返回读取的字节数
+    size_t Read(muduo::net::Buffer* buf){
+        uint64_t head = _hdr->head.load(std::memory_order_relaxed);
+        uint64_t tail = _hdr->tail.load(std::memory_order_acquire);
+        size_t n = std::min<uint64_t>(tail - head, _capacity);
+        if(n == 0) return 0;
+        buf->ensureWritableBytes(n);
+        size_t pos = head & _mask;
+        size_t first = std::min<size_t>(n, _capacity - pos);
+        std::memcpy(buf->beginWrite(), _data + pos, first);
+        std::memcpy(buf->beginWrite() + first, _data, n - first);
+        buf->hasWritten(n);
+        _hdr->head.store(head + n, std::memory_order_release);
+        return n;
+    }
+    size_t Readable() const {
+        return std::min<uint64_t>(_hdr->tail.load(std::memory_order_acquire) - _hdr->head.load(std::memory_order_acquire), _capacity);
+    }
+    size_t Writable() const {
+        return _capacity - Readable();
+    }
+    /**
+     * @brief 消费者读空后准备等待
+     * @return false 表示置位之后发现又有数据，调用方应继续读取而不是等待
+     */
+    bool PrepareReaderWait(){
+        _hdr->reader_waiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(_hdr->tail.load(std::memory_order_relaxed) != _hdr->head.load(std::memory_order_relaxed)){
+            _hdr->reader_waiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+    // 生产者写入之后调用：消费者正在等待时返回true，调用方负责唤醒，每次等待只唤醒一次
+    bool TakeReaderWaiting(){
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(_hdr->reader_waiting.load(std::memory_order_relaxed) == 0) return false;
+        return _hdr->reader_waiting.exchange(0) == 1;
+    }
+    // 生产者环满之后准备等待，返回false表示已经有空间
+    bool PrepareWriterWait(){
+        _hdr->writer_waiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(Writable() > 0){
+            _hdr->writer_waiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+    // 消费者读取之后调用：生产者正在等待空间时返回true
+    bool TakeWriterWaiting(){
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(_hdr->writer_waiting.load(std::memory_order_relaxed) == 0) return false;
+        return _hdr->writer_waiting.exchange(0) == 1;
+    }
+private:
+    ShmRingHeader* _hdr;
+    char* _data;
+    uint64_t _capacity;
+    uint64_t _mask;
+};
+
+/**
+ * @brief 一条共享内存连接的映射区域：[客户端->服务端环][服务端->客户端环]
+ */
+class ShmSegment{
+public:
+    using Ptr = std::unique_ptr<ShmSegment>;
+    ~ShmSegment(){
+        if(_base != MAP_FAILED) ::munmap(_base, _size);
+        if(_memfd >= 0) ::close(_memfd);
+    }
+    // 客户端创建共享内存并初始化两个环，ring_size 向上取整为2的幂
+    static Ptr Create(size_t ring_size){
+        ring_size = __RoundUp(ring_size);
+        int fd = ::memfd_create("rpc_shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if(fd < 0){
+            LOG_ERROR("memfd_create 失败: {}", std::strerror(errno));
+            return Ptr();
+        }
+        Ptr segment(new ShmSegment(fd, ring_size));
+        // 大小确定后封住，发给服务端之后本端也无法再改变大小，服务端访问映射区域不会因文件被截短而收到SIGBUS
+        if(::ftruncate(fd, segment->_size) < 0 || ::fcntl(fd, F_ADD_SEALS, kRequiredSeals) < 0 || segment->__Map() == false){
+            LOG_ERROR("共享内存映射失败: {}", std::strerror(errno));
+            return Ptr();
+        }
+        ShmRing::Init(segment->__RingBase(0), ring_size);
+        ShmRing::Init(segment->__RingBase(1), ring_size);
+        return segment;
+    }
+    // 服务端映射客户端传来的memfd，接管fd
+    static Ptr Attach(int memfd, size_t ring_size){
+        Ptr segment(new ShmSegment(memfd, ring_size));
+        if(ring_size < MIN_RING_SIZE || ring_size > MAX_RING_SIZE || (ring_size & (ring_size - 1)) != 0){
+            LOG_ERROR("共享内存环大小无效: {}", ring_size);
+            return Ptr();
+        }
+        // 只接受大小已被封住的memfd：否则对端映射之后仍可以截短文件，本端访问环时收到SIGBUS
+        int seals = ::fcntl(memfd, F_GET_SEALS);
+        if(seals < 0 || (seals & kRequiredSeals) != kRequiredSeals){
+            LOG_ERROR("共享内存未封住大小, 拒绝连接");
+            return Ptr();
+        }
+        struct stat st;
+        if(::fstat(memfd, &st) < 0 || static_cast<size_t>(st.st_size) < segment->_size || segment->__Map() == false){
+            LOG_ERROR("共享内存映射失败: {}", std::strerror(errno));
+            return Ptr();
+        }
+        return segment;
+    }
+    int Fd() const { return _memfd; }
+    size_t RingSize() const { return _ring_size; }
+    // is_server 为真时发送环是服务端->客户端环
+    ShmRing TxRing(bool is_server){ return ShmRing(__RingBase(is_server ? 1 : 0), _ring_size); }
+    ShmRing RxRing(bool is_server){ return ShmRing(__RingBase(is_server ? 0 : 1), _ring_size); }
+public:
+    static constexpr size_t MIN_RING_SIZE = 4096;
+    static constexpr size_t MAX_RING_SIZE = (1ul << 30);
+private:
+    static constexpr int kRequiredSeals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+    ShmSegment(int memfd, size_t ring_size)
+    :_memfd(memfd), _ring_size(ring_size), _size(2 * ShmRing::RegionSize(ring_size)), _base(MAP_FAILED){}
+    bool __Map(){
+        _base = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _memfd, 0);
+        return _base != MAP_FAILED;
+    }
+    void* __RingBase(int index){
+        return static_cast<char*>(_base) + index * ShmRing::RegionSize(_ring_size);
+    }
+    static size_t __RoundUp(size_t size){
+        size = std::min(std::max(size, MIN_RING_SIZE), MAX_RING_SIZE);
+        size_t result = MIN_RING_SIZE;
+        while(result < size) result <<= 1;
+        return result;
+    }
+private:
+    int _memfd;
+    size_t _ring_size;
+    size_t _size;
+    void* _base;
+};
+
+/**
+ * @brief 建立共享内存连接时客户端发出的握手消息，随消息以SCM_RIGHTS携带 memfd、客户端eventfd、服务端eventfd
+ */
+struct ShmHello{
+    static constexpr uint32_t MAGIC = 0x52504353; // "RPCS"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr int FD_COUNT = 3;
+    uint32_t magic = MAGIC;
+    uint32_t version = VERSION;
+    uint64_t ring_size = 0;
+};
+
+namespace detail{
+inline bool SendHello(int sockfd, const ShmHello& hello, const int (&fds)[ShmHello::FD_COUNT]){
+    char control[CMSG_SPACE(sizeof(fds))];
+    std::memset(control, 0, sizeof(control));
+    iovec iov{const_cast<ShmHello*>(&hello), sizeof(hello)};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    ssize_t n = ::sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+    if(n != static_cast<ssize_t>(sizeof(hello))){
+        LOG_ERROR("发送共享内存握手消息失败: {}", std::strerror(errno));
+        return false;
+    }
+    return true;
+}
+// 返回1表示收到完整握手，0表示数据尚未到达，-1表示出错或对端关闭；成功时fds归调用方所有。
+// 对端多发的描述符同样会被内核装入本进程，逐个检查后关闭不用的，控制缓冲区留有余量以便全部收下
+inline int RecvHello(int sockfd, ShmHello& hello, int (&fds)[ShmHello::FD_COUNT]){
+    static constexpr int kMaxFds = 16;
+    alignas(cmsghdr) char control[CMSG_SPACE(kMaxFds * sizeof(int))];
+    iovec iov{&hello, sizeof(hello)};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n = ::recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)){
+        return 0;
+    }
+    int received[kMaxFds];
+    int count = 0;
+    for(cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); n >= 0 && cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+        if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS){
+            continue;
+        }
+        int nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for(int i = 0; i < nfds && count < kMaxFds; ++i){
+            std::memcpy(&received[count++], CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+        }
+    }
+    bool ok = n == static_cast<ssize_t>(sizeof(hello)) && count == ShmHello::FD_COUNT &&
+              (msg.msg_flags & MSG_CTRUNC) == 0 && hello.magic == ShmHello::MAGIC && hello.version == ShmHello::VERSION;
+    if(ok == false){
+        for(int i = 0; i < count; ++i) ::close(received[i]);
+        LOG_ERROR("共享内存握手消息无效");
+        return -1;
+    }
+    std::memcpy(fds, received, sizeof(fds));
+    return 1;
+}
+} // namespace detail
+} // namespace base
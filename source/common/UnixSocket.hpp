@@ -0,0 +1,309 @@
+#pragma once
+
+#include <muduo/net/TcpClient.h>
+#include <muduo/net/TcpConnection.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/Channel.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <cstring>
+#include <string>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "Logging.hpp"
+
+/*
+    unix域套接字传输
+    同一主机上的客户端与服务端之间不经过TCP/IP协议栈：监听与连接使用 AF_UNIX 流式套接字，
+    建立后的fd交给 muduo::net::TcpConnection 管理，读写、缓冲区、水位回调与TCP连接完全相同
+*/
+namespace base{
+inline const std::string UNIX_SCHEME = "unix:";
+
+// 地址形如 "unix:/path/to/socket" 时使用unix域套接字
+inline bool IsUnixAddress(const std::string& address){
+    return address.compare(0, UNIX_SCHEME.size(), UNIX_SCHEME) == 0;
+}
+inline std::string UnixPath(const std::string& address){
+    return IsUnixAddress(address) ? address.substr(UNIX_SCHEME.size()) : address;
+}
+inline std::string LocalHostName(){
+    char name[256] = {0};
+    if(::gethostname(name, sizeof(name) - 1) != 0){
+        return std::string();
+    }
+    return name;
+}
+
+namespace detail{
+inline bool FillUnixAddress(const std::string& path, sockaddr_un& addr){
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(path.empty() || path.size() >= sizeof(addr.sun_path)){
+        LOG_ERROR("unix域套接字路径无效: {}", path);
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.data(), path.size());
+    return true;
+}
+} // namespace detail
+
+/**
+ * @brief unix域套接字监听器
+ * @details 监听fd挂在基础循环的Channel上，accept到的连接轮询分配到IO循环，
+ *          连接的建立、移除与销毁流程与 muduo::net::TcpServer 相同；TcpConnection 的本端与对端地址没有意义，填为空地址
+ */
+class UnixListener{
+public:
+    using AcceptCallback = std::function<void(int)>;
+    UnixListener(muduo::net::EventLoop* loop, const std::string& path, const std::string& name)
+    :_loop(loop), _path(path), _name(name), _listenfd(-1), _next_id(1), _next_loop(0)
+    {}
+    ~UnixListener(){
+        StopListening();
+        for(auto& item : _connections){
+            muduo::net::TcpConnectionPtr conn(item.second);
+            item.second.reset();
+            conn->getLoop()->runInLoop(std::bind(&muduo::net::TcpConnection::connectDestroyed, conn));
+        }
+    }
+    void SetConnectionCallback(const muduo::net::ConnectionCallback& cb){ _cb_connection = cb; }
+    void SetMessageCallback(const muduo::net::MessageCallback& cb){ _cb_message = cb; }
+    // 设置后accept到的fd直接交给回调(在基础循环中调用)，不再创建TcpConnection，例如共享内存传输用它做握手
+    void SetAcceptCallback(const AcceptCallback& cb){ _cb_accept = cb; }
+    // 与TCP监听共享IO循环，为空时连接都在基础循环上处理
+    void SetIoLoops(const std::vector<muduo::net::EventLoop*>& loops){ _ioloops = loops; }
+    // 在基础循环线程中调用
+    bool Listen(){
+        sockaddr_un addr;
+        if(detail::FillUnixAddress(_path, addr) == false){
+            return false;
+        }
+        // 上一次进程异常退出遗留的套接字文件会使bind失败
+        ::unlink(_path.c_str());
+        _listenfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(_listenfd < 0){
+            LOG_ERROR("创建unix域套接字失败: {}", std::strerror(errno));
+            return false;
+        }
+        if(::bind(_listenfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+           ::listen(_listenfd, SOMAXCONN) < 0){
+            LOG_ERROR("监听unix域套接字 {} 失败: {}", _path, std::strerror(errno));
+            ::close(_listenfd);
+            _listenfd = -1;
+            return false;
+        }
+        _channel.reset(new muduo::net::Channel(_loop, _listenfd));
+        _channel->setReadCallback(std::bind(&UnixListener::__HandleAccept, this));
+        _channel->enableReading();
+        LOG_INFO("监听unix域套接字: {}", _path);
+        return true;
+    }
+    // 停止监听并删除套接字文件，已accept的连接不受影响；在基础循环线程中调用
+    void StopListening(){
+        if(_channel){
+            _channel->disableAll();
+            _channel->remove();
+            _channel.reset();
+        }
+        if(_listenfd >= 0){
+            ::close(_listenfd);
+            _listenfd = -1;
+            ::unlink(_path.c_str());
+        }
+    }
+    const std::string& Path() const { return _path; }
+private:
+    void __HandleAccept(){
+        // 水平触发，一次读事件中取完所有已完成握手的连接
+        while(true){
+            int connfd = ::accept4(_listenfd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(connfd < 0){
+                if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+                    LOG_ERROR("unix域套接字accept失败: {}", std::strerror(errno));
+                }
+                if(errno == EINTR) continue;
+                return ;
+            }
+            if(_cb_accept){
+                _cb_accept(connfd);
+                continue;
+            }
+            muduo::net::EventLoop* ioloop = _ioloops.empty() ? _loop : _ioloops[_next_loop++ % _ioloops.size()];
+            std::string name = _name + "-unix#" + std::to_string(_next_id++);
+            auto conn = std::make_shared<muduo::net::TcpConnection>(ioloop, name, connfd,
+                                                                    muduo::net::InetAddress(), muduo::net::InetAddress());
+            _connections[name] = conn;
+            conn->setConnectionCallback(_cb_connection);
+            conn->setMessageCallback(_cb_message);
+            conn->setCloseCallback(std::bind(&UnixListener::__RemoveConnection, this, std::placeholders::_1));
+            ioloop->runInLoop(std::bind(&muduo::net::TcpConnection::connectEstablished, conn));
+        }
+    }
+    void __RemoveConnection(const muduo::net::TcpConnectionPtr& conn){
+        _loop->runInLoop([this, conn](){
+            _connections.erase(conn->name());
+            conn->getLoop()->queueInLoop(std::bind(&muduo::net::TcpConnection::connectDestroyed, conn));
+        });
+    }
+private:
+    muduo::net::EventLoop* _loop; ///< 基础循环，监听与连接表都只在这里访问
+    std::string _path;
+    std::string _name;
+    int _listenfd;
+    uint64_t _next_id;
+    std::unique_ptr<muduo::net::Channel> _channel;
+    std::vector<muduo::net::EventLoop*> _ioloops;
+    size_t _next_loop; ///< 轮询位置
+    muduo::net::ConnectionCallback _cb_connection;
+    muduo::net::MessageCallback _cb_message;
+    AcceptCallback _cb_accept;
+    std::unordered_map<std::string, muduo::net::TcpConnectionPtr> _connections;
+};
+
+/**
+ * @brief 客户端传输：MuduoClient 通过它发起连接，TCP与unix域套接字各有一个实现
+ * @details 所有方法都在所属循环的线程中调用，对象也在该线程中销毁
+ */
+class ClientSocket{
+public:
+    using ConnectFailedCallback = std::function<void()>;
+    virtual ~ClientSocket() = default;
+    virtual void SetConnectionCallback(const muduo::net::ConnectionCallback& cb) = 0;
+    virtual void SetMessageCallback(const muduo::net::MessageCallback& cb) = 0;
+    // 连接失败且不再重试时调用，可能在 Connect 中同步调用
+    virtual void SetConnectFailedCallback(const ConnectFailedCallback& cb) = 0;
+    virtual void Connect() = 0;
+    virtual void Disconnect() = 0;
+    virtual void Stop() = 0; ///< 停止尚未成功的连接重试
+    virtual muduo::net::TcpConnectionPtr Connection() = 0;
+};
+
+class TcpClientSocket : public ClientSocket{
+public:
+    TcpClientSocket(muduo::net::EventLoop* loop, const muduo::net::InetAddress& addr, const std::string& name)
+    :_client(loop, addr, name){}
+    virtual void SetConnectionCallback(const muduo::net::ConnectionCallback& cb) override{ _client.setConnectionCallback(cb); }
+    virtual void SetMessageCallback(const muduo::net::MessageCallback& cb) override{ _client.setMessageCallback(cb); }
+    // muduo的Connector失败后总是重试，不会报告失败，由上层的超时结束连接
+    virtual void SetConnectFailedCallback(const ConnectFailedCallback&) override{}
+    virtual void Connect() override{ _client.connect(); }
+    virtual void Disconnect() override{ _client.disconnect(); }
+    virtual void Stop() override{ _client.stop(); }
+    virtual muduo::net::TcpConnectionPtr Connection() override{ return _client.connection(); }
+private:
+    muduo::net::TcpClient _client;
+};
+
+/**
+ * @brief unix域套接字连接器
+ * @details 本地connect要么立即成功，要么立即失败：服务端尚未监听(ENOENT/ECONNREFUSED)或积压队列已满(EAGAIN)时
+ *          与muduo的Connector一样稍后重试，直到连接成功或被 Stop，超时由上层的定时器控制；
+ *          其他错误(如路径过长、没有权限)重试也不会成功，停止连接并调用连接失败回调
+ */
+class UnixClientSocket : public ClientSocket{
+public:
+    UnixClientSocket(muduo::net::EventLoop* loop, const std::string& path, const std::string& name)
+    :_loop(loop), _path(path), _name(name), _connecting(false)
+    {}
+    virtual ~UnixClientSocket(){
+        _loop->cancel(_retry_timer);
+        if(_connection){
+            // 连接比本对象活得久：关闭回调改为直接销毁连接
+            auto loop = _loop;
+            _connection->setCloseCallback([loop](const muduo::net::TcpConnectionPtr& conn){
+                loop->queueInLoop(std::bind(&muduo::net::TcpConnection::connectDestroyed, conn));
+            });
+            _connection->forceClose();
+        }
+    }
+    virtual void SetConnectionCallback(const muduo::net::ConnectionCallback& cb) override{ _cb_connection = cb; }
+    virtual void SetMessageCallback(const muduo::net::MessageCallback& cb) override{ _cb_message = cb; }
+    virtual void SetConnectFailedCallback(const ConnectFailedCallback& cb) override{ _cb_connect_failed = cb; }
+    virtual void Connect() override{
+        _connecting = true;
+        __TryConnect();
+    }
+    virtual void Disconnect() override{
+        _connecting = false;
+        if(_connection) _connection->shutdown();
+    }
+    virtual void Stop() override{
+        _connecting = false;
+        _loop->cancel(_retry_timer);
+    }
+    virtual muduo::net::TcpConnectionPtr Connection() override{ return _connection; }
+private:
+    static constexpr double RETRY_DELAY_SECONDS = 0.1;
+    void __TryConnect(){
+        if(_connecting == false) return ;
+        sockaddr_un addr;
+        if(detail::FillUnixAddress(_path, addr) == false){
+            return __Fail();
+        }
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(fd < 0){
+            LOG_ERROR("创建unix域套接字失败: {}", std::strerror(errno));
+            return __Fail();
+        }
+        if(::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0){
+            int err = errno;
+            ::close(fd);
+            if(err == EAGAIN || err == ENOENT || err == ECONNREFUSED || err == EINTR){
+                LOG_DEBUG("连接unix域套接字 {} 失败: {}, 稍后重试", _path, std::strerror(err));
+                _retry_timer = _loop->runAfter(RETRY_DELAY_SECONDS, std::bind(&UnixClientSocket::__TryConnect, this));
+            }
+            else{
+                LOG_ERROR("连接unix域套接字 {} 失败: {}", _path, std::strerror(err));
+                __Fail();
+            }
+            return ;
+        }
+        _connecting = false;
+        _connection = std::make_shared<muduo::net::TcpConnection>(_loop, _name + "-unix", fd,
+                                                                  muduo::net::InetAddress(), muduo::net::InetAddress());
+        _connection->setConnectionCallback(_cb_connection);
+        _connection->setMessageCallback(_cb_message);
+        _connection->setCloseCallback(std::bind(&UnixClientSocket::__RemoveConnection, this, std::placeholders::_1));
+        _connection->connectEstablished();
+    }
+    void __RemoveConnection(const muduo::net::TcpConnectionPtr& conn){
+        _connection.reset();
+        _loop->queueInLoop(std::bind(&muduo::net::TcpConnection::connectDestroyed, conn));
+    }
+    // 回调中所有者可能销毁本对象，调用之后不再访问成员
+    void __Fail(){
+        _connecting = false;
+        if(_cb_connect_failed){
+            auto cb = _cb_connect_failed;
+            cb();
+        }
+    }
+private:
+    muduo::net::EventLoop* _loop;
+    std::string _path;
+    std::string _name;
+    bool _connecting;
+    muduo::net::TimerId _retry_timer;
+    muduo::net::TcpConnectionPtr _connection;
+    muduo::net::ConnectionCallback _cb_connection;
+    muduo::net::MessageCallback _cb_message;
+    ConnectFailedCallback _cb_connect_failed;
+};
+
+class ClientSocketFactory{
+public:
+    // "unix:" 前缀的地址使用unix域套接字，否则按 ip:port 使用TCP
+    static std::unique_ptr<ClientSocket> Create(muduo::net::EventLoop* loop, const std::string& address, uint16_t port, const std::string& name){
+        if(IsUnixAddress(address)){
+            return std::unique_ptr<ClientSocket>(new UnixClientSocket(loop, UnixPath(address), name));
+        }
+        return std::unique_ptr<ClientSocket>(new TcpClientSocket(loop, muduo::net::InetAddress(address, port), name));
+    }
+};
+} // namespace base
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "Logging.hpp"
+
+/*
+    io_uring 传输的底层部件，直接使用系统调用，不依赖liburing
+    UringQueue: 提交队列与完成队列，提交的请求先放在队列中，由调用方决定何时一次性提交
+    UringBufferRing: 注册给内核的接收缓冲区环，多次触发的recv由内核从中挑选缓冲区写入，用完后归还
+*/
+namespace base{
+/**
+ * @brief io_uring 实例
+ * @details 只在一个线程中使用；队列的头尾指针与内核共享，按内核要求以 acquire/release 顺序读写
+ */
+class UringQueue{
+public:
+    using Ptr = std::unique_ptr<UringQueue>;
+    // entries 为提交队列长度，完成队列取4倍，多次触发的请求会产生连续的完成事件
+    static Ptr Create(unsigned entries){
+        io_uring_params params;
+        ::memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 4;
+        int fd = (int)::syscall(__NR_io_uring_setup, entries, &params);
+        if(fd < 0){
+            LOG_ERROR("创建io_uring失败: {}", std::strerror(errno));
+            return Ptr();
+        }
+        Ptr queue(new UringQueue(fd, params));
+        if(queue->__Map() == false){
+            return Ptr();
+        }
+        return queue;
+    }
+    ~UringQueue(){
+        if(_sqes != MAP_FAILED) ::munmap(_sqes, _params.sq_entries * sizeof(io_uring_sqe));
+        if(_cq_ptr != MAP_FAILED && _cq_ptr != _sq_ptr) ::munmap(_cq_ptr, _cq_size);
+        if(_sq_ptr != MAP_FAILED) ::munmap(_sq_ptr, _sq_size);
+        ::close(_fd);
+    }
+    int Fd(){ return _fd; }
+    // 取一个空闲的提交项并清零，队列已满时返回空，调用方先 Submit 再重试
+    io_uring_sqe* GetSqe(){
+        unsigned head = __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+        if(_sq_tail - head >= _params.sq_entries){
+            return nullptr;
+        }
+        io_uring_sqe* sqe = &_sqes[_sq_tail & *_sq_mask];
+        ++_sq_tail;
+        ::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+    // 已准备、尚未提交的请求数量
+    unsigned Pending(){
+        return _sq_tail - __atomic_load_n(_sq_ktail, __ATOMIC_RELAXED);
+    }
+    // 一次系统调用提交所有已准备的请求，不等待完成
+    int Submit(){
+        unsigned pending = Pending();
+        if(pending == 0) return 0;
+        __atomic_store_n(_sq_ktail, _sq_tail, __ATOMIC_RELEASE);
+        int ret;
+        do{
+            ret = (int)::syscall(__NR_io_uring_enter, _fd, pending, 0, 0, nullptr, 0);
+        }while(ret < 0 && errno == EINTR);
+        if(ret < 0){
+            LOG_ERROR("提交io_uring请求失败: {}", std::strerror(errno));
+        }
+        return ret;
+    }
+    // 依次处理已到达的完成事件，handler(const io_uring_cqe&)
+    template<typename Handler>
+    size_t ForEachCqe(Handler&& handler){
+        size_t count = 0;
+        unsigned head = *_cq_head;
+        while(head != __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE)){
+            io_uring_cqe cqe = _cqes[head & *_cq_mask];
+            ++head;
+            __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE); // 先归还再处理，处理过程中可能继续收取
+            handler(cqe);
+            ++count;
+        }
+        return count;
+    }
+    // 完成队列曾经写满，内核暂存了溢出的完成事件，处理完当前事件后调用 FlushOverflow 取回
+    bool CqOverflow(){
+        return __atomic_load_n(_sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW;
+    }
+    void FlushOverflow(){
+        ::syscall(__NR_io_uring_enter, _fd, 0, 0, IORING_ENTER_GETEVENTS, nullptr, 0);
+    }
+    // 完成事件到达时内核写该eventfd，从而可以挂在epoll事件循环上
+    bool RegisterEventfd(int efd){
+        int ret = (int)::syscall(__NR_io_uring_register, _fd, IORING_REGISTER_EVENTFD, &efd, 1);
+        if(ret < 0){
+            LOG_ERROR("io_uring注册eventfd失败: {}", std::strerror(errno));
+            return false;
+        }
+        return true;
+    }
+    int Register(unsigned opcode, void* arg, unsigned nr_args){
+        int ret = (int)::syscall(__NR_io_uring_register, _fd, opcode, arg, nr_args);
+        return ret < 0 ? -errno : ret;
+    }
+private:
+    UringQueue(int fd, const io_uring_params& params)
+    :_fd(fd), _params(params), _sq_ptr(MAP_FAILED), _cq_ptr(MAP_FAILED), _sqes((io_uring_sqe*)MAP_FAILED), _sq_tail(0)
+    {}
+    bool __Map(){
+        _sq_size = _params.sq_off.array + _params.sq_entries * sizeof(unsigned);
+        _cq_size = _params.cq_off.cqes + _params.cq_entries * sizeof(io_uring_cqe);
+        bool single = _params.features & IORING_FEAT_SINGLE_MMAP;
+        if(single){
+            _sq_size = _cq_size = std::max(_sq_size, _cq_size);
+        }
+        _sq_ptr = ::mmap(nullptr, _sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+        if(_sq_ptr == MAP_FAILED){
+            LOG_ERROR("映射io_uring提交队列失败: {}", std::strerror(errno));
+            return false;
+        }
+        _cq_ptr = single ? _sq_ptr : ::mmap(nullptr, _cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+        if(_cq_ptr == MAP_FAILED){
+            LOG_ERROR("映射io_uring完成队列失败: {}", std::strerror(errno));
+            return false;
+        }
+        _sqes = (io_uring_sqe*)::mmap(nullptr, _params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+        if(_sqes == MAP_FAILED){
+            LOG_ERROR("映射io_uring提交项失败: {}", std::strerror(errno));
+            return false;
+        }
+        char* sq = static_cast<char*>(_sq_ptr);
+        char* cq = static_cast<char*>(_cq_ptr);
+        _sq_head = reinterpret_cast<unsigned*>(sq + _params.sq_off.head);
+        _sq_ktail = reinterpret_cast<unsigned*>(sq + _params.sq_off.tail);
+        _sq_mask = reinterpret_cast<unsigned*>(sq + _params.sq_off.ring_mask);
+        _sq_flags = reinterpret_cast<unsigned*>(sq + _params.sq_off.flags);
+        unsigned* array = reinterpret_cast<unsigned*>(sq + _params.sq_off.array);
+        for(unsigned i = 0; i < _params.sq_entries; ++i){
+            array[i] = i; // 提交项与队列位置一一对应
+        }
+        _sq_tail = *_sq_ktail;
+        _cq_head = reinterpret_cast<unsigned*>(cq + _params.cq_off.head);
+        _cq_tail = reinterpret_cast<unsigned*>(cq + _params.cq_off.tail);
+        _cq_mask = reinterpret_cast<unsigned*>(cq + _params.cq_off.ring_mask);
+        _cqes = reinterpret_cast<io_uring_cqe*>(cq + _params.cq_off.cqes);
+        return true;
+    }
+private:
+    int _fd;
+    io_uring_params _params;
+    size_t _sq_size = 0;
+    size_t _cq_size = 0;
+    void* _sq_ptr;
+    void* _cq_ptr;
+    io_uring_sqe* _sqes;
+    unsigned* _sq_head = nullptr; ///< 内核已取走的位置
+    unsigned* _sq_ktail = nullptr; ///< 对内核可见的队尾
+    unsigned* _sq_mask = nullptr;
+    unsigned* _sq_flags = nullptr;
+    unsigned _sq_tail; ///< 本地队尾，Submit 时发布给内核
+    unsigned* _cq_head = nullptr;
+    unsigned* _cq_tail = nullptr;
+    unsigned* _cq_mask = nullptr;
+    io_uring_cqe* _cqes = nullptr;
+};
+
+/**
+ * @brief 注册给内核的接收缓冲区环(provided buffer ring)
+ * @details count 个大小为 size 的缓冲区，多次触发的recv完成时由完成事件标明使用了哪一个，
+ *          数据取走之后调用 Recycle 归还。count 必须是2的幂
+ */
+class UringBufferRing{
+public:
+    using Ptr = std::unique_ptr<UringBufferRing>;
+    static Ptr Create(UringQueue& queue, uint16_t group, unsigned count, size_t size){
+        if(count == 0 || (count & (count - 1)) != 0 || count > 32768){
+            LOG_ERROR("接收缓冲区数量 {} 必须是不超过32768的2的幂", count);
+            return Ptr();
+        }
+        Ptr ring(new UringBufferRing(group, count, size));
+        size_t ring_bytes = count * sizeof(io_uring_buf);
+        ring->_ring_bytes = ring_bytes;
+        void* mem = ::mmap(nullptr, ring_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if(mem == MAP_FAILED){
+            LOG_ERROR("分配接收缓冲区环失败: {}", std::strerror(errno));
+            return Ptr();
+        }
+        ring->_ring = static_cast<io_uring_buf*>(mem);
+        io_uring_buf_reg reg;
+        ::memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = reinterpret_cast<uint64_t>(mem);
+        reg.ring_entries = count;
+        reg.bgid = group;
+        int ret = queue.Register(IORING_REGISTER_PBUF_RING, &reg, 1);
+        if(ret < 0){
+            LOG_ERROR("注册接收缓冲区环失败: {}", std::strerror(-ret));
+            return Ptr();
+        }
+        for(unsigned i = 0; i < count; ++i){
+            ring->__Add(i, i);
+        }
+        ring->_registered = true;
+        ring->__Publish(count);
+        return ring;
+    }
+    ~UringBufferRing(){
+        if(_registered){
+            LOG_ERROR("接收缓冲区环 {} 释放时仍注册在io_uring上", _group);
+        }
+        if(_ring) ::munmap(_ring, _ring_bytes);
+    }
+    // 从内核注销，之后内核不再向这组缓冲区写入；必须在 queue 关闭之前、释放本对象之前调用
+    void Unregister(UringQueue& queue){
+        if(_registered == false) return ;
+        _registered = false;
+        io_uring_buf_reg reg;
+        ::memset(&reg, 0, sizeof(reg));
+        reg.bgid = _group;
+        int ret = queue.Register(IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        if(ret < 0){
+            LOG_ERROR("注销接收缓冲区环失败: {}", std::strerror(-ret));
+        }
+    }
+    uint16_t Group(){ return _group; }
+    size_t BufferSize(){ return _size; }
+    const char* Buffer(uint16_t bid){
+        return _buffers.data() + (size_t)bid * _size;
+    }
+    // 数据已经取走，缓冲区交还内核
+    void Recycle(uint16_t bid){
+        __Add(bid, 0);
+        __Publish(1);
+    }
+private:
+    UringBufferRing(uint16_t group, unsigned count, size_t size)
+    :_group(group), _count(count), _size(size), _buffers(count * size), _ring(nullptr), _tail(0)
+    {}
+    void __Add(uint16_t bid, unsigned offset){
+        io_uring_buf* buf = &_ring[(_tail + offset) & (_count - 1)];
+        buf->addr = reinterpret_cast<uint64_t>(Buffer(bid));
+        buf->len = (uint32_t)_size;
+        buf->bid = bid;
+    }
+    void __Publish(unsigned added){
+        _tail += added;
+        __atomic_store_n(&_ring[0].resv, _tail, __ATOMIC_RELEASE); // 环尾与第一项的resv字段重叠
+    }
+private:
+    uint16_t _group;
+    unsigned _count;
+    size_t _size;
+    std::vector<char> _buffers;
+    io_uring_buf* _ring; ///< 不使用 io_uring_buf_ring：部分内核头文件中它的柔性数组在C++下偏移8字节
+    size_t _ring_bytes = 0;
+    uint16_t _tail; ///< 本地记录的环尾，与内核共享的尾指针一样按16位回绕
+    bool _registered = false; ///< 是否仍注册在io_uring上
+};
+} // namespace base
@@ -0,0 +1,84 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include "Logging.hpp"
+
+namespace base{
+/**
+ * @brief 有界业务线程池
+ * @details 与 muduo::ThreadPool 不同，队列满时 Push 不阻塞调用方而是直接返回false，
+ *          调用方通常是IO线程，由它决定如何拒绝该任务
+ */
+class WorkerPool{
+public:
+    using Ptr = std::shared_ptr<WorkerPool>;
+    using Task = std::function<void()>;
+
+    // max_queue_size 为0表示队列不限长度
+    WorkerPool(size_t thread_num, size_t max_queue_size)
+        :_max_queue_size(max_queue_size)
+        ,_running(true)
+        {
+            for(size_t i = 0; i < thread_num; ++i){
+                _threads.emplace_back(&WorkerPool::__Run, this);
+            }
+        }
+    ~WorkerPool(){
+        Stop();
+    }
+    // 投递任务，队列已满或线程池已停止时返回false
+    bool Push(Task&& task){
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if(_running == false || (_max_queue_size > 0 && _tasks.size() >= _max_queue_size)){
+                return false;
+            }
+            _tasks.emplace_back(std::move(task));
+        }
+        _cond.notify_one();
+        return true;
+    }
+    size_t QueueSize(){
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _tasks.size();
+    }
+    // 停止接收新任务，已入队的任务执行完毕后线程退出
+    void Stop(){
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if(_running == false) return;
+            _running = false;
+        }
+        _cond.notify_all();
+        for(auto& thread : _threads){
+            if(thread.joinable()) thread.join();
+        }
+    }
+private:
+    void __Run(){
+        while(true){
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cond.wait(lock, [this](){ return _running == false || _tasks.empty() == false; });
+                if(_tasks.empty()) return; // 已停止且队列为空
+                task = std::move(_tasks.front());
+                _tasks.pop_front();
+            }
+            task();
+        }
+    }
+private:
+    size_t _max_queue_size; ///< 任务队列长度上限
+    bool _running;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::deque<Task> _tasks;
+    std::vector<std::thread> _threads;
+};
+} // namespace base
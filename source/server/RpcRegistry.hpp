@@ -2,6 +2,7 @@
 #include "../common/Net.hpp"
 #include "../common/Message.hpp"
 #include <set>
+#include <algorithm>
 #include "../common/Uuid.hpp"
 
 namespace server{
@@ -18,10 +19,11 @@ public:
         std::mutex p_mutex;
         BaseConnection::Ptr connect;
         Address host;
+        LocalEndpoint endpoint; ///< 提供者上报的本机端点，可能为空
         std::vector<std::string> methods;
 
-        Provider(const BaseConnection::Ptr& conn, const Address& host)
-            :connect(conn), host(host)
+        Provider(const BaseConnection::Ptr& conn, const Address& host, const LocalEndpoint& endpoint)
+            :connect(conn), host(host), endpoint(endpoint)
         {}
         void AppendMethod(const std::string& method){
             std::unique_lock<std::mutex> lock(p_mutex);
@@ -29,7 +31,8 @@ public:
         }
     };
     // 当一个新的服务提供者进行服务注册时调用
-    void AddProvider(const BaseConnection::Ptr& conn, const Address& host, const std::string& method){
+    void AddProvider(const BaseConnection::Ptr& conn, const Address& host, const std::string& method,
+                     const LocalEndpoint& endpoint = LocalEndpoint()){
         Provider::Ptr provider;
         // 查找连接所关联的服务提供者，找到则获取，找不到则创建，并建立关联
         {
@@ -40,7 +43,7 @@ public:
                 provider = it->second;
             }
             else{
-                provider = std::make_shared<Provider>(conn, host);
+                provider = std::make_shared<Provider>(conn, host, endpoint);
                 _conns.emplace(conn, provider);
             }
         // 注意：method方法所提供的主机要多出一个，新增_providers数据
@@ -79,7 +82,32 @@ public:
         }
         _conns.erase(conn);
     }
-    std::vector<Address> GetMethodHosts(const std::string& method){
+    /**
+     * @brief 提供者主动注销一个方法
+     * @return 注销前提供该方法的提供者，连接没有注册过该方法时返回空
+     */
+    Provider::Ptr DelMethod(const BaseConnection::Ptr& conn, const std::string& method){
+        Provider::Ptr provider;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto it = _conns.find(conn);
+            if(it == _conns.end()){
+                return Provider::Ptr();
+            }
+            provider = it->second;
+            auto providers = _providers.find(method);
+            if(providers == _providers.end() || providers->second.erase(provider) == 0){
+                return Provider::Ptr();
+            }
+        }
+        // 从提供者的方法列表中删除，之后连接断开时不再重复发送下线通知
+        std::unique_lock<std::mutex> lock(provider->p_mutex);
+        auto& methods = provider->methods;
+        methods.erase(std::remove(methods.begin(), methods.end(), method), methods.end());
+        return provider;
+    }
+    // endpoints 非空时按相同顺序填入各提供者的本机端点
+    std::vector<Address> GetMethodHosts(const std::string& method, std::vector<LocalEndpoint>* endpoints = nullptr){
         std::unique_lock<std::mutex> lock(_mutex);
         auto it = _providers.find(method);
         if(it == _providers.end()){
@@ -89,6 +117,7 @@ public:
         std::vector<Address> result;
         for(auto& provider : it->second){
             result.emplace_back(provider->host);
+            if(endpoints) endpoints->emplace_back(provider->endpoint);
         }
         return result;
     }
@@ -153,15 +182,16 @@ public:
         _conns.erase(conn);
     }
     // 当有一个新的服务提供者上线，进行上线通知
-    void OnlineNotity(const std::string& method, const Address& host){
-        return __Notify(method, host, ServiceOperType::SERVICE_ONLINE);
+    void OnlineNotity(const std::string& method, const Address& host, const LocalEndpoint& endpoint = LocalEndpoint()){
+        return __Notify(method, host, ServiceOperType::SERVICE_ONLINE, endpoint);
     }
     // 当有一个服务提供者断开连接，进行下线通知
     void OfflineNotity(const std::string& method, const Address& host){
         return __Notify(method, host, ServiceOperType::SERVICE_OFFLINE);
     }
 private:
-    void __Notify(const std::string& method, const Address& host, ServiceOperType type){
+    void __Notify(const std::string& method, const Address& host, ServiceOperType type,
+                  const LocalEndpoint& endpoint = LocalEndpoint()){
         std::unique_lock<std::mutex> lock(_mutex);
         auto it = _discoverers.find(method);
         if(it == _discoverers.end()){
@@ -173,9 +203,17 @@ private:
         msg_req->SetMessType(MessType::REQUEST_SERVICE);//
         msg_req->SetMethod(method);
         msg_req->SetHostMeassage(host);
+        msg_req->SetHostEndpoint(endpoint);
         msg_req->SetServiceOperType(type);
+        // 上下线通知对所有发现者内容相同，协商结果相同的连接共享一份编码结果
+        FrameCache frames(msg_req);
         for(auto &discoverer : it->second){
-            discoverer->connect->Send(msg_req);
+            auto frame = frames.Get(discoverer->connect);
+            if(frame.get() == nullptr){
+                LOG_ERROR("服务'{}' 上下线通知编码失败", method);
+                continue;
+            }
+            discoverer->connect->Send(frame);
         }
     }
 private:
@@ -202,6 +240,7 @@ public:
      * @details 
      *      服务注册：1. 新增服务提供者 2.进行服务上线通知
      *      服务发现：1. 新增服务发现者 
+     *      服务注销：1. 删除提供者的该方法 2.进行服务下线通知
      */
     void OnServiceRequest(const BaseConnection::Ptr& conn, const ServiceRequest::Ptr& msg){
         
@@ -210,8 +249,8 @@ public:
         if(otype == ServiceOperType::SERVICE_REGISRY){
             // 服务注册 
             LOG_INFO("{}:{} 注册服务 {}", msg->HostMeassage().first, msg->HostMeassage().second, msg->Method());
-            _providers->AddProvider(conn, msg->HostMeassage(), msg->Method());
-            _discoverers->OnlineNotity(msg->Method(), msg->HostMeassage());
+            _providers->AddProvider(conn, msg->HostMeassage(), msg->Method(), msg->HostEndpoint());
+            _discoverers->OnlineNotity(msg->Method(), msg->HostMeassage(), msg->HostEndpoint());
             __RegistryResponse(conn, msg);
         }
         else if(otype == ServiceOperType::SERVICE_DISCOVERY){
@@ -220,6 +259,15 @@ public:
             _discoverers->AddDiscoverer(conn, msg->Method());
             __DiscoveryResponse(conn, msg);
         }
+        else if(otype == ServiceOperType::SERVICE_UNREGISTRY){
+            // 服务注销：提供者下线前主动发起，发现者先于连接断开得知
+            LOG_INFO("{}:{} 注销服务 {}", msg->HostMeassage().first, msg->HostMeassage().second, msg->Method());
+            auto provider = _providers->DelMethod(conn, msg->Method());
+            if(provider.get() != nullptr){
+                _discoverers->OfflineNotity(msg->Method(), provider->host);
+            }
+            __UnregistryResponse(conn, msg);
+        }
         else{
             LOG_ERROR("收到服务操作请求，但是操作类型错误");
             __ErrorResponse(conn, msg);
@@ -247,9 +295,18 @@ private:
         msg_rsp->SetServiceOperType(ServiceOperType::SERVICE_REGISRY);
         conn->Send(msg_rsp);
     }
+    void __UnregistryResponse(const BaseConnection::Ptr& conn, const ServiceRequest::Ptr& msg){
+        auto msg_rsp = MessageFactory::Create<ServiceResponse>();
+        msg_rsp->SetId(msg->Rid());
+        msg_rsp->SetMessType(MessType::RESPONSE_SERVICE);
+        msg_rsp->SetRcode(ResCode::RCODE_OK);
+        msg_rsp->SetServiceOperType(ServiceOperType::SERVICE_UNREGISTRY);
+        conn->Send(msg_rsp);
+    }
     void __DiscoveryResponse(const BaseConnection::Ptr& conn, const ServiceRequest::Ptr& msg){
         auto msg_rsp = MessageFactory::Create<ServiceResponse>();
-        auto hosts = _providers->GetMethodHosts(msg->Method());
+        std::vector<LocalEndpoint> endpoints;
+        auto hosts = _providers->GetMethodHosts(msg->Method(), &endpoints);
         msg_rsp->SetId(msg->Rid());
         msg_rsp->SetMessType(MessType::RESPONSE_SERVICE);
         msg_rsp->SetServiceOperType(ServiceOperType::SERVICE_DISCOVERY);
@@ -262,7 +319,7 @@ private:
         
         msg_rsp->SetRcode(ResCode::RCODE_OK);
         msg_rsp->SetMethod(msg->Method());
-        msg_rsp->SetHosts(hosts);
+        msg_rsp->SetHosts(hosts, endpoints);
         conn->Send(msg_rsp);
     }
     void __ErrorResponse(const BaseConnection::Ptr& conn, const ServiceRequest::Ptr& msg){
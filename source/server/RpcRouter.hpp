@@ -1,6 +1,7 @@
 #pragma once
 #include "../common/Net.hpp"
 #include "../common/Message.hpp"
+#include "../common/WorkerPool.hpp"
 
 using namespace base;
 
@@ -139,10 +140,64 @@ class RpcRouter{
 public:
     using Ptr = std::shared_ptr<RpcRouter>;
 
-    RpcRouter():_service_manager(std::make_shared<ServiceManger>()){}
+    // worker_threads 为0时业务回调直接在IO线程中执行；
+    // 大于0时请求投递到有界业务线程池，队列超过 max_queue_size 的请求直接以 RCODE_SERVER_BUSY 拒绝；
+    // max_queue_size 默认与 ServerOptions::worker_queue_size 一致，为0表示不限制
+    RpcRouter(size_t worker_threads = 0, size_t max_queue_size = 10000)
+        :_service_manager(std::make_shared<ServiceManger>())
+        ,_inflight(0)
+        ,_draining(false)
+        {
+            if(worker_threads > 0){
+                _workers = std::make_shared<WorkerPool>(worker_threads, max_queue_size);
+            }
+        }
 
     // 注册到Dispatcher模块针对Rpc请求进行回调处理的业务函数
     void OnRpcRequest(const BaseConnection::Ptr& conn, RpcRequest::Ptr& request){
+        // 先计数再检查下线标志，与 Drain 中先置标志再等待计数归零配对，不会漏掉正在进入的请求
+        _inflight.fetch_add(1);
+        if(_draining.load()){
+            __Finish();
+            return Response(conn, request, Json::Value(), ResCode::RCODE_SERVER_DRAINING);
+        }
+        if(_workers.get() == nullptr){
+            __HandleRequest(conn, request);
+            return __Finish();
+        }
+        bool ret = _workers->Push([this, conn, request]() mutable{
+            __HandleRequest(conn, request);
+            __Finish();
+        });
+        if(ret == false){
+            __Finish();
+            LOG_ERROR("业务线程池队列已满, 拒绝 {} 请求", request->Method());
+            return Response(conn, request, Json::Value(), ResCode::RCODE_SERVER_BUSY);
+        }
+    }
+    /**
+     * @brief 停止接收请求，之后到达的请求以 RCODE_SERVER_DRAINING 应答；等待已接收的请求处理完毕
+     * @return 在 deadline 之前全部处理完毕返回 true
+     */
+    bool Drain(std::chrono::steady_clock::time_point deadline){
+        _draining.store(true);
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _idle.wait_until(lock, deadline, [this](){ return _inflight.load() == 0; });
+    }
+    size_t Inflight(){
+        return _inflight.load();
+    }
+    void RegisterMethod(const ServiceDiscribe::Ptr& service){
+        return _service_manager->Insert(service);
+    }
+private:
+    void __Finish(){
+        if(_inflight.fetch_sub(1) == 1 && _draining.load()){
+            std::unique_lock<std::mutex> lock(_mutex);
+            _idle.notify_all();
+        }
+    }
+    void __HandleRequest(const BaseConnection::Ptr& conn, RpcRequest::Ptr& request){
         //1. 查询客户端请求的方法描述--判断当前服务端是否能提供响应的服务
         auto service = _service_manager->Select(request->Method());
         if(service.get() == nullptr){
@@ -162,12 +217,9 @@ public:
             return Response(conn, request, Json::Value(), ResCode::RCODE_INTERNAL_ERROR);  
         }
         //4. 处理完毕得到结果，组织响应， 向客户端发送
+        //   在业务线程中发送时，由连接负责把写操作投递回所属IO线程
         return Response(conn, request, result, ResCode::RCODE_OK);  
     }
-    void RegisterMethod(const ServiceDiscribe::Ptr& service){
-        return _service_manager->Insert(service);
-    }
-private:
     void Response(const BaseConnection::Ptr& conn, RpcRequest::Ptr& req, 
         const Json::Value& res, ResCode rcode){
         auto msg = MessageFactory::Create<RpcResponse>();
@@ -179,5 +231,10 @@ private:
     }
 private:
     ServiceManger::Ptr _service_manager;
+    WorkerPool::Ptr _workers; ///< 业务线程池，为空表示在IO线程中直接处理
+    std::atomic<size_t> _inflight; ///< 已接收、尚未应答的请求数量
+    std::atomic<bool> _draining; ///< 正在下线，不再处理新请求
+    std::mutex _mutex;
+    std::condition_variable _idle; ///< 下线期间请求全部处理完毕时通知
 };   
 }
\ No newline at end of file
@@ -13,7 +13,7 @@ namespace server{
 class RegistryServer{
 public:
     using Ptr = std::shared_ptr<RegistryServer>;
-    RegistryServer(int16_t port)
+    RegistryServer(int16_t port, const ServerOptions& options = ServerOptions())
         :_pd_manager(std::make_shared<PDManager>())
         ,_dispatcher(std::make_shared<Dispatcher>())
         {
@@ -21,7 +21,9 @@ public:
                         std::placeholders::_1, std::placeholders::_2);
             _dispatcher->RegisterHandler<ServiceRequest>(MessType::REQUEST_SERVICE, service_cb); //注册映射关系
             
-            _server = base::ServerFactory::Create(port);
+            ServerOptions server_options = options;
+            server_options.backpressure.SetDefaultPolicy(BackpressurePolicy::PAUSE_READ);
+            _server = base::ServerFactory::Create(port, server_options);
 
             auto message_callback = std::bind(&Dispatcher::OnMessage, _dispatcher.get(),
                                     std::placeholders::_1, std::placeholders::_2);
@@ -49,14 +51,21 @@ public:
     // rpc_server 端有两套地址信息，
     // 1. rpc服务提供端地址信息 -- 必须是rpc服务端对外访问地址（云服务器 -- 监听地址和访问地址不同）
     // 2. 注册中心服务端地址信息 -- 启用服务注册后，连接注册中心进行服务注册
+    // options 用于配置底层网络服务与业务线程池，例如IO线程数量、业务线程数量
     RpcServer(const Address& access_addr, 
             bool enableRegistry = false,
-            const Address& registry_server_addr = Address())
+            const Address& registry_server_addr = Address(),
+            const ServerOptions& options = ServerOptions())
         :_access_addr(access_addr)
         ,_enable_registry(enableRegistry)
-        ,_router(std::make_shared<RpcRouter>())
+        ,_router(std::make_shared<RpcRouter>(options.worker_threads, options.worker_queue_size))
         ,_dispatcher(std::make_shared<Dispatcher>())
         {
+            // 同时监听unix域套接字时，注册信息中带上主机名与套接字路径；服务器类型不支持时不上报
+            if(base::ServerFactory::ListensOnUnixPath(options)){
+                _local_endpoint.host_name = LocalHostName();
+                _local_endpoint.unix_path = options.unix_path;
+            }
             if(enableRegistry == true){
                 _client_registry = std::make_shared<client::RegistryClient>(
                     registry_server_addr.first, registry_server_addr.second);
@@ -66,7 +75,10 @@ public:
                         std::placeholders::_1, std::placeholders::_2);
             _dispatcher->RegisterHandler<RpcRequest>(MessType::REQUEST_RPC, rpc_cb); //注册映射关系
 
-            _server = base::ServerFactory::Create(access_addr.second);
+            // 请求-响应服务：发送缓冲区积压时暂停读取，请求方随之放慢
+            ServerOptions server_options = options;
+            server_options.backpressure.SetDefaultPolicy(BackpressurePolicy::PAUSE_READ);
+            _server = base::ServerFactory::Create(access_addr.second, server_options);
 
             auto message_callback = std::bind(&Dispatcher::OnMessage, _dispatcher.get(),
                                     std::placeholders::_1, std::placeholders::_2);
@@ -74,26 +86,54 @@ public:
         }
     void RegistryMethod(const ServiceDiscribe::Ptr& service){
         if(_enable_registry){
-            _client_registry->RegistryMethod(service->MethodName(), _access_addr);
+            _client_registry->RegistryMethod(service->MethodName(), _access_addr, _local_endpoint);
+            _methods.push_back(service->MethodName());
         }
         _router->RegisterMethod(service);
     }
     void Start(){
         _server->Start();
     }
+    /**
+     * @brief 优雅下线，用于滚动发布
+     * @details 1. 向注册中心注销所有方法，服务发现客户端收到下线通知后不再选择本节点
+     *          2. 之后到达的请求以 RCODE_SERVER_DRAINING 应答；这些请求没有被处理，客户端总是将其改发到其他服务提供者
+     *          3. 等待已接收的请求处理完毕
+     *          4. 关闭所有连接的写端，已排队的响应写完后退出主循环，Start 返回
+     *          整个过程最多 timeout_ms；会阻塞调用者，需要在 Start 所在线程以外调用，例如信号处理线程
+     */
+    void Drain(int timeout_ms = 5000){
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        if(_enable_registry){
+            for(auto& method : _methods){
+                _client_registry->UnregistryMethod(method, _access_addr);
+            }
+        }
+        if(_router->Drain(deadline) == false){
+            LOG_ERROR("等待请求处理超时, 仍有 {} 个请求未完成", _router->Inflight());
+        }
+        auto remain = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        _server->Stop(std::max<int>(remain.count(), 0));
+    }
+    // 所有连接尚未写入内核的字节数之和
+    size_t QueuedBytes(){
+        return _server->QueuedBytes();
+    }
 private:
     Address _access_addr;
+    LocalEndpoint _local_endpoint; ///< 本机端点，没有监听unix域套接字时为空
     bool _enable_registry;    
     RpcRouter::Ptr _router;
     Dispatcher::Ptr _dispatcher;
     BaseServer::Ptr _server;
     client::RegistryClient::Ptr _client_registry;
+    std::vector<std::string> _methods; ///< 已向注册中心注册的方法，下线时注销
 };
 
 class TopicServer{
 public:
     using Ptr = std::shared_ptr<TopicServer>;
-    TopicServer(int16_t port)
+    TopicServer(int16_t port, const ServerOptions& options = ServerOptions())
         :_topic_manager(std::make_shared<TopicManager>())
         ,_dispatcher(std::make_shared<Dispatcher>())
         {
@@ -101,7 +141,10 @@ public:
                         std::placeholders::_1, std::placeholders::_2);
             _dispatcher->RegisterHandler<TopicRequest>(MessType::REQUEST_TOPIC, topic_cb); //注册映射关系
             
-            _server = base::ServerFactory::Create(port);
+            // 主题广播：慢订阅者的发送缓冲区积压时丢弃新消息，不拖慢发布者与其他订阅者
+            ServerOptions server_options = options;
+            server_options.backpressure.SetDefaultPolicy(BackpressurePolicy::DROP);
+            _server = base::ServerFactory::Create(port, server_options);
 
             auto message_callback = std::bind(&Dispatcher::OnMessage, _dispatcher.get(),
                                     std::placeholders::_1, std::placeholders::_2);
@@ -113,6 +156,10 @@ public:
         void Start(){
             _server->Start();
         }
+        // 所有连接尚未写入内核的字节数之和，慢订阅者积压时升高
+        size_t QueuedBytes(){
+            return _server->QueuedBytes();
+        }
 private:
     void __OnConnShutDown(const BaseConnection::Ptr& conn){
         _topic_manager->OnShutDown(conn);
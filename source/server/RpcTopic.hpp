@@ -201,8 +201,15 @@ private:
         // 收到消息发布请求
         void PushMessage(const BaseMessage::Ptr& msg){
             std::unique_lock<std::mutex> lock(t_mutex);
+            // 协商结果相同的订阅者共享同一份不可变的帧数据，消息一般只编码一次
+            FrameCache frames(msg);
             for(auto& subscriber : subscribers){
-                subscriber->conn->Send(msg); // 广播消息
+                auto frame = frames.Get(subscriber->conn);
+                if(frame.get() == nullptr){
+                    LOG_ERROR("{} 主题消息编码失败", topic_name);
+                    continue;
+                }
+                subscriber->conn->Send(frame); // 广播消息
             }
         }
     };
@@ -0,0 +1,85 @@
+#include "../../source/common/Net.hpp"
+#include <chrono>
+
+using namespace base;
+
+// 构造正文约为 payload 字节的RPC请求
+static BaseMessage::Ptr BuildRequest(size_t payload){
+    auto req = MessageFactory::Create<RpcRequest>();
+    req->SetId("1e0a5bd24d8a4a06-0000000000000001");
+    req->SetMessType(MessType::REQUEST_RPC);
+    req->SetMethod("Echo");
+    Json::Value params;
+    params["data"] = std::string(payload, 'x');
+    req->SetParams(params);
+    return req;
+}
+
+static double NowNs(){
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 单独计算校验值的吞吐(GB/s)
+template<typename Func>
+static double CrcThroughput(const std::string& data, int rounds, Func&& func){
+    uint32_t crc = 0;
+    double begin = NowNs();
+    for(int i = 0; i < rounds; ++i){
+        crc = func(data.data(), data.size(), crc);
+    }
+    double cost = NowNs() - begin;
+    if(crc == 0x12345678) LOG_INFO("{}", crc); // 防止计算被优化掉
+    return data.size() * (double)rounds / cost;
+}
+
+// 编码 + 解析一条消息的平均耗时(ns)，包含JSON序列化与反序列化，与连接上的实际路径一致
+static double EncodeDecode(const BaseMessage::Ptr& msg, uint32_t capabilities, int rounds){
+    FrameOptions options;
+    options.capabilities = capabilities;
+    options.stream_chunk_size = 0;
+    LVProtocol tx(options), rx(options);
+    tx.Negotiate(PROTOCOL_VERSION, capabilities);
+    muduo::net::Buffer out, in;
+    size_t decoded = 0;
+    double begin = NowNs();
+    for(int i = 0; i < rounds; ++i){
+        MuduoBuffer out_buffer(&out);
+        tx.Serialize(msg, out_buffer);
+        in.append(out.peek(), out.readableBytes());
+        out.retrieveAll();
+        MuduoBuffer in_buffer(&in);
+        BaseMessage::Ptr result;
+        if(rx.CanProcessed(in_buffer) && rx.OnMessage(in_buffer, result) && result){
+            ++decoded;
+        }
+    }
+    double cost = NowNs() - begin;
+    if(decoded != (size_t)rounds){
+        LOG_ERROR("解析出的消息数量错误: {} != {}", decoded, rounds);
+        std::exit(1);
+    }
+    return cost / rounds;
+}
+
+int main(int argc, char* argv[]){
+    size_t payload = argc > 1 ? std::atoi(argv[1]) : 1024;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 200000;
+
+    std::string data(payload, 'x');
+    printf("CRC32C %zu 字节: 查表 %.2f GB/s, 硬件 %.2f GB/s (SSE4.2 %s)\n", payload,
+           CrcThroughput(data, rounds * 10, &common::Crc32c::Software),
+           CrcThroughput(data, rounds * 10, &common::Crc32c::Hardware),
+           common::Crc32c::HardwareAvailable() ? "可用" : "不可用");
+
+    auto msg = BuildRequest(payload);
+    EncodeDecode(msg, CAP_STREAMING, rounds / 10); // 预热
+    // 两种配置交替运行多次取最小值，减少频率变化与调度带来的噪声
+    double plain = 1e18, checked = 1e18;
+    for(int i = 0; i < 5; ++i){
+        plain = std::min(plain, EncodeDecode(msg, CAP_STREAMING, rounds / 5));
+        checked = std::min(checked, EncodeDecode(msg, CAP_STREAMING | CAP_CHECKSUM, rounds / 5));
+    }
+    printf("编码+解析 %zu 字节正文: 无校验 %.0f ns/msg, 带校验 %.0f ns/msg, 开销 %.2f%%\n",
+           payload, plain, checked, (checked - plain) / plain * 100);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#include "../../source/client/RpcClient.hpp"
+#include "../../source/common/Logging.hpp"
+
+using namespace base;
+using namespace client;
+
+// 先启动 ServerTest：请求还没有响应时销毁客户端，调用方应当立即得到断开错误，而不是一直等待
+int main(){
+    auto client = std::make_unique<RpcClient>(false, "127.0.0.1", 9090);
+
+    Json::Value param;
+    param["ms"] = 3000;
+    RpcCaller::JsonAsyncResponse res_future;
+    if(client->Call("Sleep", param, res_future) == false){
+        LOG_ERROR("发起调用失败");
+        return 1;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200)); // 等请求发出
+    client.reset();
+
+    if(res_future.wait_for(std::chrono::seconds(1)) != std::future_status::ready){
+        LOG_ERROR("FAIL: 客户端销毁后请求仍未结束");
+        return 1;
+    }
+    try{
+        res_future.get();
+        LOG_ERROR("FAIL: 客户端销毁后请求不应成功");
+        return 1;
+    }
+    catch(const std::exception& e){
+        LOG_INFO("PASS: 请求以错误结束: {}", e.what());
+    }
+    return 0;
+}
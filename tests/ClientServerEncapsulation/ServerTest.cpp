@@ -9,6 +9,11 @@ void Add(const Json::Value& req, Json::Value& rsp){
     int num2 = req["num2"].asInt();
     rsp = num1 + num2;
 }
+// 迟迟不返回的方法，供 DetachTest 制造未完成的请求
+void Sleep(const Json::Value& req, Json::Value& rsp){
+    std::this_thread::sleep_for(std::chrono::milliseconds(req["ms"].asInt()));
+    rsp = req["ms"].asInt();
+}
 int main(){
     // 初始化服务构造器
     std::unique_ptr<ServiceDiscribeFactory> server_factory(new ServiceDiscribeFactory());
@@ -19,8 +24,15 @@ int main(){
     server_factory->SetReturnType(ValueType::INTERGRAL);
     server_factory->SetCallback(Add);
     
+    std::unique_ptr<ServiceDiscribeFactory> sleep_factory(new ServiceDiscribeFactory());
+    sleep_factory->SetMethodName("Sleep");
+    sleep_factory->SetParamsDesc("ms", ValueType::INTERGRAL);
+    sleep_factory->SetReturnType(ValueType::INTERGRAL);
+    sleep_factory->SetCallback(Sleep);
+
     RpcServer server({"127.0.0.1", 9090});
     server.RegistryMethod(server_factory->Build());
+    server.RegistryMethod(sleep_factory->Build());
     server.Start();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// 基准程序共用的计数分配器：替换全局 operator new/delete，g_allocs 统计堆分配次数
+// 标量与数组形式成对替换，任何 new 得到的指针都由对应的 delete 以 free 释放
+// 替换函数不能声明为inline，每个程序只能在一个源文件中包含本头文件
+static size_t g_allocs = 0;
+static void* CountedAlloc(size_t size){
+    ++g_allocs;
+    if(void* p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(size_t size){ return CountedAlloc(size); }
+void* operator new[](size_t size){ return CountedAlloc(size); }
+void operator delete(void* p) noexcept{ std::free(p); }
+void operator delete(void* p, size_t) noexcept{ std::free(p); }
+void operator delete[](void* p) noexcept{ std::free(p); }
+void operator delete[](void* p, size_t) noexcept{ std::free(p); }
@@ -0,0 +1,80 @@
+#include "../../source/common/JsonComm.hpp"
+#include "../CountingAllocator.hpp"
+#include <chrono>
+#include <sstream>
+
+using namespace common;
+
+// 堆分配次数由 g_allocs 统计，观察每条消息序列化与反序列化产生的分配
+
+// 旧实现：每次调用构造builder、writer/reader与stringstream
+static bool LegacySerialize(const Json::Value& value, std::string& body){
+    Json::StreamWriterBuilder Wbuilder;
+    Wbuilder["emitUTF8"] = true;
+    std::unique_ptr<Json::StreamWriter> Swriter(Wbuilder.newStreamWriter());
+    std::stringstream ss;
+    if(Swriter->write(value, &ss) != 0) return false;
+    body = ss.str();
+    return true;
+}
+static bool LegacyUnSerialize(std::string_view body, Json::Value& rvalue){
+    Json::CharReaderBuilder CBuilder;
+    CBuilder["emitUTF8"] = true;
+    std::unique_ptr<Json::CharReader> Creader(CBuilder.newCharReader());
+    std::string error;
+    return Creader->parse(body.data(), body.data()+body.size(), &rvalue, &error);
+}
+
+// 与RPC请求正文相同的结构
+static Json::Value BuildBody(){
+    Json::Value body, params;
+    params["num1"] = 11;
+    params["num2"] = 22;
+    params["name"] = "张三";
+    body["method"] = "Add";
+    body["parameters"] = params;
+    return body;
+}
+
+struct Result{
+    double ns_per_msg;
+    double allocs_per_msg;
+};
+
+template<typename Func>
+static Result Run(int rounds, Func&& func){
+    func(); // 预热，线程局部对象在这里创建
+    size_t allocs = g_allocs;
+    auto begin = std::chrono::steady_clock::now();
+    for(int i = 0; i < rounds; ++i){
+        if(func() == false){
+            LOG_ERROR("json 编解码失败");
+            std::exit(1);
+        }
+    }
+    auto cost = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+    return Result{(double)cost / rounds, (double)(g_allocs - allocs) / rounds};
+}
+
+// 用法: ./JsonCodecBench [rounds]
+int main(int argc, char* argv[]){
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 200000;
+    Json::Value body = BuildBody();
+    std::string legacy_text, text;
+    LegacySerialize(body, legacy_text);
+    JsonUtil::Serialize(body, text);
+
+    std::string out;
+    auto w_legacy = Run(rounds, [&](){ return LegacySerialize(body, out); });
+    auto w_cached = Run(rounds, [&](){ return JsonUtil::Serialize(body, out); }); // 复用 out 的容量
+    Json::Value value;
+    auto r_legacy = Run(rounds, [&](){ return LegacyUnSerialize(legacy_text, value); });
+    auto r_cached = Run(rounds, [&](){ return JsonUtil::UnSerialize(text, value); });
+
+    printf("正文长度: 旧实现 %zu 字节, 紧凑格式 %zu 字节\n", legacy_text.size(), text.size());
+    printf("序列化:   旧实现 %.0f ns/msg %.1f 次分配/msg, 缓存 %.0f ns/msg %.1f 次分配/msg\n",
+           w_legacy.ns_per_msg, w_legacy.allocs_per_msg, w_cached.ns_per_msg, w_cached.allocs_per_msg);
+    printf("反序列化: 旧实现 %.0f ns/msg %.1f 次分配/msg, 缓存 %.0f ns/msg %.1f 次分配/msg\n",
+           r_legacy.ns_per_msg, r_legacy.allocs_per_msg, r_cached.ns_per_msg, r_cached.allocs_per_msg);
+    return 0;
+}
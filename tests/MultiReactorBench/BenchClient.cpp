@@ -0,0 +1,39 @@
+#include "../../source/client/RpcClient.hpp"
+#include "../../source/common/Logging.hpp"
+#include <atomic>
+#include <thread>
+
+using namespace base;
+using namespace client;
+
+// 用法: ./BenchClient <connections> <seconds> [port]
+// 每个连接一个线程，循环发起同步Add调用，统计整体吞吐
+int main(int argc, char* argv[]){
+    int connections = argc > 1 ? std::atoi(argv[1]) : 16;
+    int seconds = argc > 2 ? std::atoi(argv[2]) : 10;
+    int16_t port = argc > 3 ? std::atoi(argv[3]) : 9090;
+
+    std::atomic<bool> running(true);
+    std::atomic<uint64_t> total(0);
+    std::atomic<uint64_t> failed(0);
+    std::vector<std::thread> workers;
+    for(int i = 0; i < connections; ++i){
+        workers.emplace_back([&, i](){
+            RpcClient client(false, "127.0.0.1", port);
+            Json::Value param, result;
+            param["num1"] = i;
+            param["num2"] = 1;
+            while(running){
+                if(client.Call("Add", param, result)) ++total;
+                else ++failed;
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    running = false;
+    for(auto& worker : workers) worker.join();
+
+    LOG_INFO("connections: {}, seconds: {}, calls: {}, failed: {}, qps: {}",
+        connections, seconds, total.load(), failed.load(), total.load() / seconds);
+    return 0;
+}
@@ -0,0 +1,31 @@
+#include "../../source/server/RpcServer.hpp"
+#include "../../source/common/Logging.hpp"
+
+using namespace base;
+using namespace server;
+
+void Add(const Json::Value& req, Json::Value& rsp){
+    int num1 = req["num1"].asInt();
+    int num2 = req["num2"].asInt();
+    rsp = num1 + num2;
+}
+// 用法: ./BenchServer <io_threads> [port]
+int main(int argc, char* argv[]){
+    int io_threads = argc > 1 ? std::atoi(argv[1]) : 0;
+    int16_t port = argc > 2 ? std::atoi(argv[2]) : 9090;
+
+    std::unique_ptr<ServiceDiscribeFactory> server_factory(new ServiceDiscribeFactory());
+    server_factory->SetMethodName("Add");
+    server_factory->SetParamsDesc("num1", ValueType::INTERGRAL);
+    server_factory->SetParamsDesc("num2", ValueType::INTERGRAL);
+    server_factory->SetReturnType(ValueType::INTERGRAL);
+    server_factory->SetCallback(Add);
+
+    ServerOptions options;
+    options.io_threads = io_threads;
+    LOG_INFO("压测服务端启动, IO线程数: {}, 端口: {}", io_threads, port);
+    RpcServer server({"127.0.0.1", port}, false, Address(), options);
+    server.RegistryMethod(server_factory->Build());
+    server.Start();
+    return 0;
+}
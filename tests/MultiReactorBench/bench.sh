@@ -0,0 +1,19 @@
+#!/bin/bash
+# 依次以 1..N 个IO线程启动服务端，用相同的客户端压力测量吞吐
+# 用法: ./bench.sh [max_threads] [connections] [seconds]
+MAX_THREADS=${1:-$(nproc)}
+CONNECTIONS=${2:-64}
+SECONDS_PER_RUN=${3:-10}
+PORT=9090
+
+threads=1
+while [ $threads -le $MAX_THREADS ]; do
+    ./BenchServer $threads $PORT > /dev/null &
+    server_pid=$!
+    sleep 1
+    echo "io_threads=$threads"
+    ./BenchClient $CONNECTIONS $SECONDS_PER_RUN $PORT | grep qps
+    kill $server_pid
+    wait $server_pid 2>/dev/null
+    threads=$((threads * 2))
+done
@@ -0,0 +1,96 @@
+#include "../../source/common/Net.hpp"
+#include "../CountingAllocator.hpp"
+#include <chrono>
+
+using namespace base;
+
+// 堆分配次数由 g_allocs 统计，用于观察每次读事件是否产生额外分配
+
+// 构造一段包含 frames 条RPC请求帧的字节流
+static std::string BuildStream(size_t frames){
+    auto protocol = ProtocolFactory::Create();
+    std::string stream;
+    for(size_t i = 0; i < frames; ++i){
+        auto req = MessageFactory::Create<RpcRequest>();
+        req->SetId(std::to_string(i));
+        req->SetMessType(MessType::REQUEST_RPC);
+        req->SetMethod("Add");
+        Json::Value params;
+        params["num1"] = (int)i;
+        params["num2"] = 1;
+        req->SetParams(params);
+        stream.append(protocol->Serialize(req));
+    }
+    return stream;
+}
+
+struct Result{
+    double ns_per_frame;
+    double allocs_per_read;
+};
+
+// 以 read_size 为单位把字节流喂给解析循环，模拟每次读事件到来的数据
+template<typename Decode>
+static Result Run(const std::string& stream, size_t frames, size_t read_size, int rounds, Decode&& decode){
+    muduo::net::Buffer in;
+    size_t decoded = 0, reads = 0;
+    size_t allocs = g_allocs;
+    auto begin = std::chrono::steady_clock::now();
+    for(int r = 0; r < rounds; ++r){
+        for(size_t off = 0; off < stream.size(); off += read_size){
+            in.append(stream.data() + off, std::min(read_size, stream.size() - off));
+            decoded += decode(&in);
+            ++reads;
+        }
+    }
+    auto cost = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+    allocs = g_allocs - allocs;
+    if(decoded != frames * rounds){
+        LOG_ERROR("解析出的消息数量错误: {} != {}", decoded, frames * rounds);
+        std::exit(1);
+    }
+    // 每条消息本身的构造与反序列化所需的分配在各实现间相同，这里只看每次读事件的平均分配次数
+    return Result{(double)cost / decoded, (double)allocs / reads};
+}
+
+// 用法: ./PipelineBench [frames] [read_size] [rounds]
+int main(int argc, char* argv[]){
+    size_t frames = argc > 1 ? std::atoi(argv[1]) : 10000;
+    size_t read_size = argc > 2 ? std::atoi(argv[2]) : 4096;
+    int rounds = argc > 3 ? std::atoi(argv[3]) : 20;
+    std::string stream = BuildStream(frames);
+    FrameOptions options;
+
+    // 旧实现：每次读事件通过 BufferFactory 在堆上创建缓冲区包装对象，经由虚接口解析
+    BaseProtocol::Ptr legacy = ProtocolFactory::Create(options);
+    auto r_legacy = Run(stream, frames, read_size, rounds, [&](muduo::net::Buffer* buf){
+        size_t n = 0;
+        auto base_buffer = BufferFactory::Create(buf);
+        while(legacy->CanProcessed(base_buffer)){
+            BaseMessage::Ptr msg;
+            if(legacy->OnMessage(base_buffer, msg) == false) std::exit(1);
+            if(msg) ++n;
+        }
+        return n;
+    });
+    // MuduoServer：缓冲区在栈上，协议经由虚接口
+    BaseProtocol::Ptr virt = ProtocolFactory::Create(options);
+    auto r_virtual = Run(stream, frames, read_size, rounds, [&](muduo::net::Buffer* buf){
+        size_t n = 0;
+        ProcessFrames<BaseProtocol, MuduoBuffer>(*virt, buf, options.max_frame_size, [&](BaseMessage::Ptr&){ ++n; });
+        return n;
+    });
+    // LVMuduoServer：协议与缓冲区类型在编译期确定
+    auto lv = ProtocolFactory::CreateAs<LVProtocol>(options);
+    auto r_static = Run(stream, frames, read_size, rounds, [&](muduo::net::Buffer* buf){
+        size_t n = 0;
+        ProcessFrames<LVProtocol, MuduoBuffer>(*lv, buf, options.max_frame_size, [&](BaseMessage::Ptr&){ ++n; });
+        return n;
+    });
+    std::printf("frames=%zu bytes=%zu read_size=%zu rounds=%d\n", frames, stream.size(), read_size, rounds);
+    std::printf("%-28s %10s %16s\n", "pipeline", "ns/frame", "allocs/read");
+    std::printf("%-28s %10.1f %16.2f\n", "legacy(BufferFactory)", r_legacy.ns_per_frame, r_legacy.allocs_per_read);
+    std::printf("%-28s %10.1f %16.2f\n", "MuduoServer(virtual)", r_virtual.ns_per_frame, r_virtual.allocs_per_read);
+    std::printf("%-28s %10.1f %16.2f\n", "LVMuduoServer(static)", r_static.ns_per_frame, r_static.allocs_per_read);
+    return 0;
+}
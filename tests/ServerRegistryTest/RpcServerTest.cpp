@@ -1,5 +1,7 @@
 #include "../../source/server/RpcServer.hpp"
 #include "../../source/common/Logging.hpp"
+#include <csignal>
+#include <thread>
 
 using namespace base;
 using namespace server;
@@ -20,9 +22,22 @@ int main(){
     server_factory->SetReturnType(ValueType::INTERGRAL);
     server_factory->SetCallback(Add);
     
+    // SIGINT/SIGTERM 交给单独的线程处理，收到后优雅下线
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
     RpcServer server({"127.0.0.1", 9090}, true, {"127.0.0.1", 8080});
     server.RegistryMethod(server_factory->Build());
+    std::thread stopper([&server, signals](){
+        int signo = 0;
+        sigwait(&signals, &signo);
+        server.Drain(3000);
+    });
     server.Start();
+    stopper.join();
 
     return 0;
 }
\ No newline at end of file
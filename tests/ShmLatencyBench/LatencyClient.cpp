@@ -0,0 +1,57 @@
+#include "../../source/client/RpcClient.hpp"
+#include "../../source/common/Logging.hpp"
+#include <algorithm>
+#include <chrono>
+
+using namespace base;
+using namespace client;
+
+// 单连接顺序发起同步调用，统计每次调用的往返延迟
+static void Run(const std::string& name, const std::string& ip, int16_t port, int calls, const ClientOptions& options){
+    RpcClient client(false, ip, port, options);
+    Json::Value param, result;
+    // 预热：建立连接并让两端的缓冲区与代码路径就绪
+    for(int i = 0; i < 1000; ++i){
+        param["num"] = i;
+        client.Call("Echo", param, result);
+    }
+    std::vector<double> latency;
+    latency.reserve(calls);
+    int failed = 0;
+    for(int i = 0; i < calls; ++i){
+        param["num"] = i;
+        auto start = std::chrono::steady_clock::now();
+        bool ok = client.Call("Echo", param, result);
+        auto end = std::chrono::steady_clock::now();
+        if(ok == false || result.asInt() != i){
+            ++failed;
+            continue;
+        }
+        latency.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    if(latency.empty()){
+        LOG_ERROR("{}: 全部调用失败", name);
+        return ;
+    }
+    std::sort(latency.begin(), latency.end());
+    double sum = 0;
+    for(double v : latency) sum += v;
+    auto pct = [&](double p){ return latency[std::min(latency.size() - 1, static_cast<size_t>(p * latency.size()))]; };
+    LOG_INFO("{}: calls {}, failed {}, avg {:.2f}us, p50 {:.2f}us, p99 {:.2f}us, p999 {:.2f}us",
+        name, latency.size(), failed, sum / latency.size(), pct(0.5), pct(0.99), pct(0.999));
+}
+// 用法: ./LatencyClient [calls] [port] [shm_path] [busy_poll_us]
+int main(int argc, char* argv[]){
+    int calls = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int16_t port = argc > 2 ? std::atoi(argv[2]) : 9090;
+    std::string shm_path = argc > 3 ? argv[3] : "/tmp/rpc_latency.sock";
+    int busy_poll_us = argc > 4 ? std::atoi(argv[4]) : 0;
+
+    ClientLoopPool::Instance().SetThreadNum(1);
+    ClientOptions options;
+    options.devirtualize = true;
+    Run("tcp loopback", "127.0.0.1", port, calls, options);
+    options.shm.busy_poll_us = busy_poll_us;
+    Run("shared memory", SHM_SCHEME + shm_path, 0, calls, options);
+    return 0;
+}
@@ -0,0 +1,40 @@
+#include "../../source/server/RpcServer.hpp"
+#include "../../source/common/Logging.hpp"
+#include <thread>
+
+using namespace base;
+using namespace server;
+
+void Echo(const Json::Value& req, Json::Value& rsp){
+    rsp = req["num"];
+}
+ServiceDiscribe::Ptr EchoService(){
+    std::unique_ptr<ServiceDiscribeFactory> factory(new ServiceDiscribeFactory());
+    factory->SetMethodName("Echo");
+    factory->SetParamsDesc("num", ValueType::INTERGRAL);
+    factory->SetReturnType(ValueType::INTERGRAL);
+    factory->SetCallback(Echo);
+    return factory->Build();
+}
+// 用法: ./LatencyServer [port] [shm_path] [busy_poll_us]
+// 同一个Echo服务分别在TCP回环与共享内存上提供，两者都是单个IO循环
+int main(int argc, char* argv[]){
+    int16_t port = argc > 1 ? std::atoi(argv[1]) : 9090;
+    std::string shm_path = argc > 2 ? argv[2] : "/tmp/rpc_latency.sock";
+    int busy_poll_us = argc > 3 ? std::atoi(argv[3]) : 0;
+
+    std::thread shm_thread([&](){
+        ServerOptions options;
+        options.shm_path = shm_path;
+        options.shm.busy_poll_us = busy_poll_us;
+        RpcServer server({"127.0.0.1", port}, false, Address(), options);
+        server.RegistryMethod(EchoService());
+        server.Start();
+    });
+    LOG_INFO("延迟测试服务端启动, TCP端口: {}, 共享内存: {}", port, shm_path);
+    RpcServer server({"127.0.0.1", port}, false, Address());
+    server.RegistryMethod(EchoService());
+    server.Start();
+    shm_thread.join();
+    return 0;
+}
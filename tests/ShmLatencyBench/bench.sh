@@ -0,0 +1,14 @@
+#!/bin/bash
+# 对比TCP回环与共享内存传输的单连接往返延迟
+# 用法: ./bench.sh [calls] [busy_poll_us]
+CALLS=${1:-100000}
+BUSY_POLL_US=${2:-0}
+PORT=9090
+SHM_PATH=/tmp/rpc_latency.sock
+
+./LatencyServer $PORT $SHM_PATH $BUSY_POLL_US > /dev/null &
+server_pid=$!
+sleep 1
+./LatencyClient $CALLS $PORT $SHM_PATH $BUSY_POLL_US | grep calls
+kill $server_pid
+wait $server_pid 2>/dev/null
@@ -0,0 +1,59 @@
+#include "../../source/client/RpcClient.hpp"
+#include "../../source/common/Logging.hpp"
+#include <atomic>
+#include <thread>
+
+using namespace base;
+using namespace client;
+
+// 用法: ./UringClient <muduo|uring> <connections> <seconds> [depth] [port]
+// 一个RpcClient对服务端建立 connections 条连接，每条连接保持 depth 个未完成的异步调用，
+// 响应回调中立即发起下一个调用(闭环)，统计整体吞吐。连接数可以远大于线程数
+int main(int argc, char* argv[]){
+    std::string mode = argc > 1 ? argv[1] : "uring";
+    int connections = argc > 2 ? std::atoi(argv[2]) : 1000;
+    int seconds = argc > 3 ? std::atoi(argv[3]) : 10;
+    int depth = argc > 4 ? std::atoi(argv[4]) : 4;
+    int16_t port = argc > 5 ? std::atoi(argv[5]) : 9090;
+
+    ClientOptions options;
+    options.connections_per_host = connections;
+    options.devirtualize = true;
+    options.io_uring = mode == "uring";
+    RpcClient client(false, "127.0.0.1", port, options);
+
+    std::atomic<bool> running(true);
+    std::atomic<uint64_t> total(0);
+    std::atomic<uint64_t> failed(0);
+    std::atomic<int64_t> inflight(0);
+    Json::Value param;
+    param["num1"] = 1;
+    param["num2"] = 1;
+    std::function<void()> issue;
+    RpcCaller::JsonResponseCallback on_response = [&](const Json::Value& result){
+        if(result.isInt()) ++total;
+        else ++failed;
+        if(running) issue();
+        else --inflight;
+    };
+    issue = [&](){
+        if(client.Call("Add", param, on_response) == false){
+            ++failed;
+            --inflight;
+        }
+    };
+    for(int i = 0; i < connections * depth; ++i){
+        ++inflight;
+        issue();
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    running = false;
+    // 等待已发出的调用全部返回，回调引用的对象才能析构
+    for(int i = 0; i < 300 && inflight > 0; ++i){
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    LOG_INFO("transport: {}, connections: {}, depth: {}, seconds: {}, calls: {}, failed: {}, qps: {}",
+        mode, connections, depth, seconds, total.load(), failed.load(), total.load() / seconds);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#include "../../source/server/RpcServer.hpp"
+#include "../../source/common/Logging.hpp"
+
+using namespace base;
+using namespace server;
+
+void Add(const Json::Value& req, Json::Value& rsp){
+    int num1 = req["num1"].asInt();
+    int num2 = req["num2"].asInt();
+    rsp = num1 + num2;
+}
+// 用法: ./UringServer <muduo|uring> [io_threads] [port]
+int main(int argc, char* argv[]){
+    std::string mode = argc > 1 ? argv[1] : "uring";
+    int io_threads = argc > 2 ? std::atoi(argv[2]) : 4;
+    int16_t port = argc > 3 ? std::atoi(argv[3]) : 9090;
+
+    std::unique_ptr<ServiceDiscribeFactory> server_factory(new ServiceDiscribeFactory());
+    server_factory->SetMethodName("Add");
+    server_factory->SetParamsDesc("num1", ValueType::INTERGRAL);
+    server_factory->SetParamsDesc("num2", ValueType::INTERGRAL);
+    server_factory->SetReturnType(ValueType::INTERGRAL);
+    server_factory->SetCallback(Add);
+
+    ServerOptions options;
+    options.io_threads = io_threads;
+    options.devirtualize = true;
+    options.io_uring = mode == "uring";
+    LOG_INFO("压测服务端启动, 传输: {}, IO线程数: {}, 端口: {}", mode, io_threads, port);
+    RpcServer server({"127.0.0.1", port}, false, Address(), options);
+    server.RegistryMethod(server_factory->Build());
+    server.Start();
+    return 0;
+}
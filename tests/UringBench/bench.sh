@@ -0,0 +1,19 @@
+#!/bin/bash
+# 在同样的连接数下分别以muduo(epoll)与io_uring传输启动服务端，客户端使用相同的传输，对比吞吐
+# 用法: ./bench.sh [io_threads] [seconds] [depth]
+IO_THREADS=${1:-4}
+SECONDS_PER_RUN=${2:-10}
+DEPTH=${3:-4}
+PORT=9090
+ulimit -n 65536
+
+for connections in 100 1000 5000; do
+    for mode in muduo uring; do
+        ./UringServer $mode $IO_THREADS $PORT > /dev/null &
+        server_pid=$!
+        sleep 1
+        ./UringClient $mode $connections $SECONDS_PER_RUN $DEPTH $PORT | grep qps
+        kill $server_pid
+        wait $server_pid 2>/dev/null
+    done
+done
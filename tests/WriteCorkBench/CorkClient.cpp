@@ -0,0 +1,48 @@
+#include "../../source/client/RpcClient.hpp"
+#include "../../source/common/Logging.hpp"
+#include <atomic>
+#include <thread>
+
+using namespace base;
+using namespace client;
+
+// 用法: ./CorkClient <connections> <pipeline> <seconds> [port]
+// 每个连接一次连续发出 pipeline 个异步小请求，全部收到响应后再发下一批
+int main(int argc, char* argv[]){
+    int connections = argc > 1 ? std::atoi(argv[1]) : 8;
+    int pipeline = argc > 2 ? std::atoi(argv[2]) : 32;
+    int seconds = argc > 3 ? std::atoi(argv[3]) : 10;
+    int16_t port = argc > 4 ? std::atoi(argv[4]) : 9090;
+
+    std::atomic<bool> running(true);
+    std::atomic<uint64_t> total(0);
+    std::vector<std::thread> workers;
+    for(int i = 0; i < connections; ++i){
+        workers.emplace_back([&, i](){
+            RpcClient client(false, "127.0.0.1", port);
+            Json::Value param;
+            param["num1"] = i;
+            param["num2"] = 1;
+            std::vector<RpcCaller::JsonAsyncResponse> futures(pipeline);
+            while(running){
+                int sent = 0;
+                for(; sent < pipeline; ++sent){
+                    if(client.Call("Add", param, futures[sent]) == false) break;
+                }
+                for(int j = 0; j < sent; ++j){
+                    futures[j].get();
+                }
+                total += sent;
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    running = false;
+    for(auto& worker : workers) worker.join();
+
+    // calls 一行供 bench.sh 计算每条消息的写系统调用次数
+    LOG_INFO("connections: {}, pipeline: {}, seconds: {}, qps: {}",
+        connections, pipeline, seconds, total.load() / seconds);
+    std::cout << "calls " << total.load() << std::endl;
+    return 0;
+}
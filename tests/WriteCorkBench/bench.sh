@@ -0,0 +1,24 @@
+#!/bin/bash
+# 分别在关闭/开启写合并的情况下压测小请求，
+# 通过 /proc/<pid>/io 中的 syscw 统计服务端写系统调用次数，计算每条消息的写调用数
+# 用法: ./bench.sh [connections] [pipeline] [seconds]
+CONNECTIONS=${1:-8}
+PIPELINE=${2:-32}
+SECONDS_PER_RUN=${3:-10}
+PORT=9090
+
+for cork in 0 1; do
+    ./CorkServer $cork $PORT > /dev/null &
+    server_pid=$!
+    sleep 1
+    before=$(awk '/syscw/{print $2}' /proc/$server_pid/io)
+    output=$(./CorkClient $CONNECTIONS $PIPELINE $SECONDS_PER_RUN $PORT)
+    after=$(awk '/syscw/{print $2}' /proc/$server_pid/io)
+    kill $server_pid
+    wait $server_pid 2>/dev/null
+
+    calls=$(echo "$output" | awk '/^calls/{print $2}')
+    echo "cork_writes=$cork"
+    echo "$output" | grep qps
+    awk -v w=$((after - before)) -v c=$calls 'BEGIN{printf "write syscalls: %d, per message: %.3f\n", w, (c > 0 ? w / c : 0)}'
+done